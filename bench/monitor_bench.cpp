@@ -0,0 +1,367 @@
+/*
+monitor_bench measures the per-tick hot paths of the monitor
+
+  monitor_bench [options]
+
+Each benchmark runs its operation until --min-time has passed and reports the
+average wall time, heap allocations and system calls per operation. The
+fixture is a synthetic proc tree built by procgen in a temporary directory
+under /dev/shm, or an existing tree given with --proc and --etc, such as the
+real /proc and /etc.
+
+Allocations are counted by replacing the global operator new. System calls
+are counted by wrapping the libc functions the monitor calls to read files
+and directories, so futexes taken by the worker pool, and the calls libc makes
+internally (getpwuid_r(), std::ifstream), are not included.
+*/
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "history.h"
+#include "linux_parser.h"
+#include "pid_scanner.h"
+#include "process.h"
+#include "process_sorter.h"
+#include "process_tree.h"
+#include "system.h"
+#include "user_cache.h"
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+#define VISIBLE_ROWS 40  // processes kept in order by the sort benchmarks
+
+namespace {
+std::atomic<unsigned long> allocations{0};
+std::atomic<unsigned long> syscalls{0};
+
+template <typename F>
+F Real(const char* name) {
+  return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+}  // namespace
+
+// Replacements for the global allocation functions
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+// Wrappers for the libc functions the monitor reads /proc and /etc with
+extern "C" {
+int open(const char* path, int flags, ...) {
+  static auto real = Real<int (*)(const char*, int, ...)>("open");
+  va_list args;
+  va_start(args, flags);
+  mode_t mode = va_arg(args, mode_t);
+  va_end(args);
+  syscalls.fetch_add(1, std::memory_order_relaxed);
+  return real(path, flags, mode);
+}
+
+ssize_t read(int fd, void* buffer, size_t size) {
+  static auto real = Real<ssize_t (*)(int, void*, size_t)>("read");
+  syscalls.fetch_add(1, std::memory_order_relaxed);
+  return real(fd, buffer, size);
+}
+
+ssize_t pread(int fd, void* buffer, size_t size, off_t offset) {
+  static auto real = Real<ssize_t (*)(int, void*, size_t, off_t)>("pread");
+  syscalls.fetch_add(1, std::memory_order_relaxed);
+  return real(fd, buffer, size, offset);
+}
+
+off_t lseek(int fd, off_t offset, int whence) {
+  static auto real = Real<off_t (*)(int, off_t, int)>("lseek");
+  syscalls.fetch_add(1, std::memory_order_relaxed);
+  return real(fd, offset, whence);
+}
+
+int close(int fd) {
+  static auto real = Real<int (*)(int)>("close");
+  syscalls.fetch_add(1, std::memory_order_relaxed);
+  return real(fd);
+}
+
+int stat(const char* path, struct stat* status) noexcept {
+  static auto real = Real<int (*)(const char*, struct stat*)>("stat");
+  syscalls.fetch_add(1, std::memory_order_relaxed);
+  return real(path, status);
+}
+
+// Every caller in the process comes through here, so all six arguments a
+// system call can take are passed on, as glibc's syscall() reads them. The
+// ones a call does not take are read but ignored by the kernel.
+long syscall(long number, ...) {
+  static auto real = Real<long (*)(long, ...)>("syscall");
+  va_list args;
+  va_start(args, number);
+  long a = va_arg(args, long), b = va_arg(args, long), c = va_arg(args, long),
+       d = va_arg(args, long), e = va_arg(args, long), f = va_arg(args, long);
+  va_end(args);
+  syscalls.fetch_add(1, std::memory_order_relaxed);
+  return real(number, a, b, c, d, e, f);
+}
+}
+
+namespace {
+struct Options {
+  unsigned long processes{1000};
+  double min_time{0.5};
+  string filter;
+  string proc;
+  string etc;
+};
+
+struct Result {
+  double ns;
+  double allocations;
+  double syscalls;
+};
+
+/*
+ * Calls op in batches of doubling size until the last batch took at least
+ * min_time seconds, and reports the averages of that batch.
+ */
+Result Measure(const std::function<void()>& op, double min_time) {
+  op();  // warm up caches and buffers
+  for (unsigned long n = 1;; n *= 2) {
+    unsigned long allocations_before = allocations.load();
+    unsigned long syscalls_before = syscalls.load();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < n; i++) {
+      op();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (elapsed.count() >= min_time || n >= (1UL << 40)) {
+      return {elapsed.count() * 1e9 / n,
+              (double)(allocations.load() - allocations_before) / n,
+              (double)(syscalls.load() - syscalls_before) / n};
+    }
+  }
+}
+
+void Report(const Options& options, const string& name,
+            const std::function<void()>& op) {
+  if (name.find(options.filter) == string::npos) {
+    return;
+  }
+  Result result = Measure(op, options.min_time);
+  printf("%-36s %14.1f %12.2f %12.2f\n", name.c_str(), result.ns,
+         result.allocations, result.syscalls);
+  fflush(stdout);
+}
+
+int Remove(const char* path, const struct stat*, int, struct FTW*) {
+  return remove(path);
+}
+
+/*
+ * Runs procgen to build a tree of the given size in a new temporary directory,
+ * and returns the directory, or an empty string on failure.
+ */
+string BuildFixture(unsigned long processes) {
+  char shm[] = "/dev/shm/monitor_bench.XXXXXX";
+  char tmp[] = "/tmp/monitor_bench.XXXXXX";
+  const char* root = mkdtemp(shm);
+  if (!root) {
+    root = mkdtemp(tmp);
+  }
+  if (!root) {
+    return string();
+  }
+  string count = std::to_string(processes);
+  pid_t child = fork();
+  if (child == 0) {
+    execl(PROCGEN_PATH, "procgen", "--once", "-p", count.c_str(), root,
+          (char*)nullptr);
+    _exit(127);
+  }
+  int status = 0;
+  if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    nftw(root, Remove, 16, FTW_DEPTH | FTW_PHYS);
+    return string();
+  }
+  return root;
+}
+
+void Usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -p, --processes N   processes in the generated fixture "
+          "(default: 1000)\n"
+          "  -m, --min-time SECS minimum time spent on each benchmark "
+          "(default: 0.5)\n"
+          "  -f, --filter TEXT   only run benchmarks whose name contains "
+          "TEXT\n"
+          "      --proc DIR      use DIR instead of a generated fixture, "
+          "such as /proc\n"
+          "      --etc DIR       use DIR with --proc (default: /etc)\n",
+          name);
+}
+
+void Run(const Options& options) {
+  printf("%-36s %14s %12s %12s\n", "benchmark", "ns/op", "allocs/op",
+         "syscalls/op");
+
+  // a process of the fixture, other than init
+  vector<unsigned int> pids;
+  PidScanner scanner(LinuxParser::ProcDirectory());
+  scanner.Scan(pids);
+  unsigned int pid = pids.size() > 1 ? pids[1] : 1;
+  string stat_path = LinuxParser::PidPath(pid, LinuxParser::kStatFilename);
+  string stat_line(LinuxParser::GetLineFromFile(stat_path.c_str()));
+  string status_path = LinuxParser::PidPath(pid, LinuxParser::kStatusFilename);
+
+  Report(options, "LinuxParser::GetValueFromLine", [&]() {
+    volatile size_t size =
+        LinuxParser::GetValueFromLine(stat_line, LinuxParser::kStartTime_ - 1)
+            .size();
+    (void)size;
+  });
+  Report(options, "LinuxParser::GetLineFromFile", [&]() {
+    volatile size_t size =
+        LinuxParser::GetLineFromFile(status_path.c_str(), LinuxParser::kVmRSS)
+            .size();
+    (void)size;
+  });
+  Report(options, "PidScanner::Scan", [&]() { scanner.Scan(pids); });
+  UserCache users(LinuxParser::EtcPath(LinuxParser::kPasswordFilename));
+  Report(options, "User(pid)", [&]() {
+    unsigned int uid = 0;
+    LinuxParser::ParseNumber(LinuxParser::Uid(pid), uid);
+    volatile size_t size = users.Name(uid).size();
+    (void)size;
+  });
+  Process process(pid, "user", "command");
+  unsigned long generation = 1;
+  double uptime = LinuxParser::UpTime(LinuxParser::ReadFile(
+      LinuxParser::ProcPath(LinuxParser::kUptimeFilename).c_str()));
+  Report(options, "Process::Update",
+         [&]() { process.Update(uptime, generation++); });
+
+  System system(0, false);
+  system.UpdateProcesses();
+  printf("# System with %zu processes\n", system.Processes().size());
+  Report(options, "System::UpdateProcessors",
+         [&]() { system.UpdateProcessors(); });
+  Report(options, "System::UpdateProcesses",
+         [&]() { system.UpdateProcesses(); });
+
+  const char* keys[] = {"Pid", "User", "State", "Cpu",
+                        "Ram", "UpTime", "Command"};
+  ProcessSorter sorter;
+  for (int sort = System::kPid_; sort <= System::kCommand_; sort++) {
+    Report(options, string("ProcessSorter::Sort/") + keys[sort], [&]() {
+      sorter.Sort(system.Processes(), (System::Sort_t)sort, true,
+                  VISIBLE_ROWS);
+    });
+  }
+
+  ProcessTree tree;
+  vector<unsigned int> tree_order;
+  vector<TreeNode> tree_nodes;
+  Report(options, "ProcessTree::Update+Flatten", [&]() {
+    tree.Update(system.Processes());
+    tree.Flatten(system.Processes(), tree_order, tree_nodes);
+  });
+
+  // a tick of history for the cpus and a screen of processes
+  History history(system.TotalCpus());
+  Report(options, "History::Add", [&]() {
+    history.AddCpus(system.Cpu(), system.Cpus());
+    const vector<Process>& processes = system.Processes();
+    for (size_t i = 0; i < processes.size() && i < VISIBLE_ROWS; i++) {
+      history.AddProcess(processes[i]);
+    }
+  });
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  const struct option long_options[] = {
+      {"processes", required_argument, nullptr, 'p'},
+      {"min-time", required_argument, nullptr, 'm'},
+      {"filter", required_argument, nullptr, 'f'},
+      {"proc", required_argument, nullptr, 'P'},
+      {"etc", required_argument, nullptr, 'E'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "p:m:f:h", long_options, nullptr)) !=
+         -1) {
+    switch (opt) {
+      case 'p':
+        options.processes = strtoul(optarg, nullptr, 10);
+        break;
+      case 'm':
+        options.min_time = strtod(optarg, nullptr);
+        break;
+      case 'f':
+        options.filter = optarg;
+        break;
+      case 'P':
+        options.proc = optarg;
+        break;
+      case 'E':
+        options.etc = optarg;
+        break;
+      case 'h':
+        Usage(argv[0]);
+        return 0;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+
+  string fixture;
+  if (options.proc.empty()) {
+    fixture = BuildFixture(options.processes);
+    if (fixture.empty()) {
+      fprintf(stderr, "%s: cannot build the fixture with %s\n", argv[0],
+              PROCGEN_PATH);
+      return 1;
+    }
+    LinuxParser::SetRoots(fixture + "/proc", fixture + "/etc");
+  } else {
+    LinuxParser::SetRoots(options.proc, options.etc.empty()
+                                            ? LinuxParser::kEtcRoot
+                                            : options.etc);
+  }
+  Run(options);
+  if (!fixture.empty()) {
+    nftw(fixture.c_str(), Remove, 16, FTW_DEPTH | FTW_PHYS);
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef BATCH_DISPLAY_H
+#define BATCH_DISPLAY_H
+
+#include <vector>
+
+#include "instrumentation.h"
+#include "output_buffer.h"
+#include "snapshot.h"
+#include "snapshot_source.h"
+#include "system.h"
+
+namespace BatchDisplay {
+enum Format_t { kJsonl_ = 0, kCsv_ };
+
+void CsvHeader(OutputBuffer& out);
+void Csv(OutputBuffer& out, const Snapshot& snapshot, double time,
+         const std::vector<unsigned int>& order, size_t n,
+         const Instrumentation& timings);
+void Jsonl(OutputBuffer& out, const Snapshot& snapshot, double time,
+           const std::vector<unsigned int>& order, size_t n,
+           const Instrumentation& timings);
+int Display(System& system, SnapshotSource& source, unsigned long iterations,
+            Format_t format, size_t top);
+};  // namespace BatchDisplay
+
+#endif
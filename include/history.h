@@ -0,0 +1,58 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "process.h"
+#include "processor.h"
+
+#define HISTORY_SAMPLES 300    // samples kept per series
+#define HISTORY_PROCESSES 256  // processes whose samples are kept at once
+
+/*
+Recent samples of the cpus and of the processes near the screen
+Every series is a ring of HISTORY_SAMPLES quantized values, stored side by
+side in one array per metric, all allocated up front, so adding a sample
+writes a single value and never allocates. Core utilization is kept in 8
+bits. A process is given one of HISTORY_PROCESSES slots when it is first
+added, taking the slot least recently added to when all are in use, and keeps
+its CPU% as a share of every cpu and its RAM on a log scale, in 16 bits each.
+History is filled and read by the display thread only.
+*/
+class History {
+ public:
+  explicit History(int cpus);
+  void AddCpus(const Processor& cpu, const std::vector<Processor>& cpus);
+  void AddProcess(const Process& process);
+  void Cpu(int series, size_t n, std::vector<float>& samples) const;
+  void ProcessCpu(const Process& process, size_t n,
+                  std::vector<float>& samples) const;
+  void ProcessRam(const Process& process, size_t n,
+                  std::vector<float>& samples) const;
+
+ private:
+  int cpus_;
+  size_t series_;  // the aggregate, then one per cpu
+  unsigned long tick_{1};  // starts past 0, which marks a free slot
+  // all cpu series share a position, as they are added together
+  size_t cpu_head_{0};
+  size_t cpu_count_{0};
+  std::vector<uint8_t> cpu_;  // series_ rings
+  // per process slot
+  std::vector<unsigned int> pids_;
+  std::vector<unsigned long long> starts_;
+  std::vector<unsigned long> used_;  // tick of the last sample, 0 if free
+  std::vector<uint16_t> heads_;
+  std::vector<uint16_t> counts_;
+  std::vector<uint16_t> process_cpu_;  // HISTORY_PROCESSES rings
+  std::vector<uint16_t> process_ram_;  // HISTORY_PROCESSES rings
+
+  int Find(const Process& process) const;
+  template <typename T, typename Decode>
+  static void Read(const T* ring, size_t head, size_t count, size_t n,
+                   std::vector<float>& samples, Decode decode);
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define TIMING_WINDOW 128  // ticks kept per phase for the percentiles
+
+/*
+Timings of the monitor's own work, per phase of a tick
+Time spent in a phase is added up with ScopedTimer, and EndTick() closes the
+tick for a range of phases, keeping the last TIMING_WINDOW totals of each.
+Each phase must only be timed from one thread: the Sampler times the phases
+of System::UpdateProcesses(), and the display those of a redraw. Samples are
+stored in atomics, so Summary() can be called from any thread without a lock.
+*/
+class Instrumentation {
+ public:
+  enum Phase_t {
+    kScan_ = 0,
+    kParse_,
+    kReconcile_,
+    kSort_,
+    kRender_,
+    kRefresh_,
+    kTotalPhases_
+  };
+
+  // milliseconds over the last ticks, all zero until a tick has ended
+  struct Summary {
+    double p50{0.0};
+    double p99{0.0};
+  };
+
+  static const std::string& Name(Phase_t phase);
+  void Add(Phase_t phase, std::chrono::steady_clock::duration time);
+  void EndTick(Phase_t first, Phase_t last);
+  Summary Percentiles(Phase_t phase) const;
+  void UpdateSelf();
+  float SelfCpu() const;
+  unsigned long SelfRam() const;
+
+ private:
+  struct Ring {
+    std::atomic<uint64_t> pending{0};  // ns, added up during the tick
+    std::atomic<uint64_t> count{0};    // ticks ended
+    std::atomic<uint64_t> samples[TIMING_WINDOW]{};
+  };
+
+  Ring phases_[kTotalPhases_];
+  // refreshed by UpdateSelf(), on the display thread
+  std::chrono::steady_clock::time_point self_time_{};
+  double self_cpu_time_{0.0};
+  float self_cpu_{0.0};
+  unsigned long self_ram_{0};
+};
+
+/*
+Adds the time from its construction to its destruction to a phase
+*/
+class ScopedTimer {
+ public:
+  ScopedTimer(Instrumentation& instrumentation, Instrumentation::Phase_t phase);
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  ~ScopedTimer();
+
+ private:
+  Instrumentation& instrumentation_;
+  Instrumentation::Phase_t phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif
@@ -1,26 +1,36 @@
 #ifndef SYSTEM_PARSER_H
 #define SYSTEM_PARSER_H
 
+#include <charconv>
 #include <string>
-#include <vector>
+#include <string_view>
+
+#include "pid_stat.h"
 
 namespace LinuxParser {
 // Paths
-const std::string kProcDirectory{"/proc/"};
+// The proc and etc roots can be moved with SetRoots(), for instance to a
+// synthetic tree built by procgen. Paths under them are built by the functions
+// below, so the change must be made before the first System is created.
+const std::string kProcRoot{"/proc"};
+const std::string kEtcRoot{"/etc"};
 const std::string kCmdlineFilename{"/cmdline"};
 const std::string kCpuinfoFilename{"/cpuinfo"};
 const std::string kStatusFilename{"/status"};
 const std::string kStatFilename{"/stat"};
+const std::string kTaskDirectory{"/task/"};
 const std::string kUptimeFilename{"/uptime"};
 const std::string kMeminfoFilename{"/meminfo"};
 const std::string kVersionFilename{"/version"};
-const std::string kOSPath{"/etc/os-release"};
-const std::string kPasswordPath{"/etc/passwd"};
+const std::string kOSFilename{"/os-release"};
+const std::string kPasswordFilename{"/passwd"};
 
 // Keys
 const std::string kCpu{"cpu"};
 const std::string kProcesses{"processes"};
 const std::string kProcsRunning{"procs_running"};
+const std::string kCtxt{"ctxt"};
+const std::string kIntr{"intr"};
 const std::string kVmRSS{"VmRSS:"};
 const std::string kUid{"Uid:"};
 
@@ -82,35 +92,52 @@ enum PidStat {
   kStartTime_,
 };
 
+// Roots
+void SetRoots(std::string proc, std::string etc);
+bool DefaultProcRoot();
+const std::string& ProcDirectory();
+std::string ProcPath(const std::string& filename);
+std::string EtcPath(const std::string& filename);
+
 // Helpers
-std::string GetLineFromFile(const std::string& path, const std::string& key);
-std::vector<std::string> GetValuesFromLine(const std::string& line);
-std::string GetValueFromLine(const std::string& line, const int index = 0);
-void FixTokenInParens(std::string& line);
+// Views returned by these helpers point into a per-thread buffer, and remain
+// valid only until the next file is read on the same thread.
+const char* PidPath(unsigned int pid, const std::string& filename);
+const char* TaskPath(unsigned int pid, unsigned int tid,
+                     const std::string& filename);
+std::string_view ReadFile(const char* path);
+std::string_view GetLineFromFile(const char* path, std::string_view key = {});
+std::string_view NextLine(std::string_view& contents);
+std::string_view NextToken(std::string_view& line);
+std::string_view GetValueFromLine(std::string_view line, const int index = 0);
+
+/*
+ * Converts token to a number without allocating. Returns false if token does
+ * not begin with a number, in which case value is left unchanged.
+ */
+template <typename T>
+bool ParseNumber(std::string_view token, T& value) {
+  auto result =
+      std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc();
+}
 
 // System
 std::string Kernel();
 std::string OperatingSystem();
-std::vector<unsigned int> Pids();
-float MemoryUtilization();
-unsigned long UpTime();
-unsigned long Jiffies(int index = -1);
-unsigned long ActiveJiffies(int index = -1);
-unsigned long IdleJiffies(int index = -1);
-unsigned long TotalProcesses();
-unsigned long RunningProcesses();
-std::vector<std::string> CpuUtilization(int index = -1);
-int GetTotalCpus();
+float MemoryUtilization(std::string_view meminfo);
+double UpTime(std::string_view uptime);
 
 // Processes
 std::string Command(unsigned int pid);
 std::string Filename(unsigned int pid);
-std::string Ram(unsigned int pid);
+unsigned long Ram(unsigned int pid);
 std::string Uid(unsigned int pid);
-std::string User(unsigned int pid);
-unsigned long UpTime(unsigned int pid);
-unsigned long ActiveJiffies(unsigned int pid);
-std::string State(unsigned int pid);
+bool ReadPidStat(unsigned int pid, ::PidStat& stat);
+
+// Threads
+std::string ThreadName(unsigned int pid, unsigned int tid);
+bool ReadTaskStat(unsigned int pid, unsigned int tid, ::PidStat& stat);
 };  // namespace LinuxParser
 
 #endif
\ No newline at end of file
@@ -3,13 +3,36 @@
 
 #include <curses.h>
 
+#include <cstddef>
+#include <vector>
+
+#include "history.h"
 #include "process.h"
+#include "process_sorter.h"
+#include "snapshot.h"
+#include "snapshot_source.h"
 #include "system.h"
 
 #define SYSTEM_SHOW_CORE_STATIC_ROWS 6
 #define SYSTEM_HIDE_CORE_STATIC_ROWS 8
+#define GRAPH_COLUMN_WIDTH 20  // samples shown in the process graph column
 
 namespace NCursesDisplay {
+/*
+Scroll position of the process list
+top is the index in the sort order of the first row shown, and selected that
+of the highlighted row. The selection follows its pid when the order changes,
+unless a key has just moved it. In the tree, the processes in collapsed have
+their descendants hidden.
+*/
+struct Viewport {
+  size_t top{0};
+  size_t selected{0};
+  unsigned int selected_pid{0};
+  bool moved{false};  // selected was set by a key since the last frame
+  std::vector<unsigned int> collapsed;  // sorted pids
+};
+
 // system info
 const std::string kOs{"Operating System: "};
 const std::string kKernel{"Kernel: "};
@@ -19,6 +42,10 @@ const std::string kMemory{"Memory:"};
 const std::string kTotal{"Total Processes: "};
 const std::string kRunning{"Running Processes: "};
 const std::string kAlive{"Alive Processes: "};
+const std::string kExited{"Exited: "};
+const std::string kShortLived{"Short-lived: "};
+const std::string kTimings{"ms p50/p99: "};
+const std::string kSelf{"self: "};
 
 // processes
 const std::string kPid{"PID"};
@@ -28,30 +55,53 @@ const std::string kCpu{"CPU%%"};
 const std::string kRam{"RAM[MB]"};
 const std::string kTime{"TIME+"};
 const std::string kCommand{"COMMAND"};
+const std::string kCpuGraph{"CPU GRAPH"};
+const std::string kRamGraph{"RAM GRAPH"};
+const std::string kThreadPrefix{"  `- "};  // before the name of a thread
+const std::string kCollapsed{"+ "};  // before a process with hidden children
+const std::string kExpanded{"- "};   // before a process with children shown
+// sparkline characters, from the lowest value to the highest
+const std::string kSparkLevels{" .:-=+*#"};
 
 // menu
-const std::string kHideCores{"Hide Cores"};
-const std::string kShowCores{"Show Cores"};
+// the h of hide and show is the key, as H toggles the threads
+const std::string kHideCores{"Cores: hide"};
+const std::string kShowCores{"Cores: show"};
 const std::string kSortOrder{"Sort Order: "};
 const std::string kQuit{"Quit"};
 
-int Keypress(void);
-void CheckEvents(System& system, WINDOW* system_w, WINDOW* process_w, int& n);
-void ClearLine(WINDOW* window, int row);
+int CheckEvents(System& system, WINDOW* system_w, WINDOW* process_w, int& n,
+                Viewport& viewport);
+void MoveSelection(Viewport& viewport, long rows, bool page);
+void Collapse(Viewport& viewport, int collapse);
+void PlaceViewport(System& system, const Snapshot& snapshot,
+                   ProcessSorter& sorter, Viewport& viewport, int n);
 void BoldUnderlineAndColor(WINDOW* window, int color, int row, int col,
                            std::string str, size_t pos = 0);
 void AddColorChar(WINDOW* window, int color, chtype c);
 void Resize(System& system, WINDOW* system_w, WINDOW* process_w, int& n);
+int WindowSizeSignalFd();
+void ResizeTerminal(int signal_fd);
 std::string ProgressBar(float percent);
+std::string Sparkline(const std::vector<float>& samples, float high,
+                      size_t width);
 void SystemMenu(System& system, WINDOW* window, int& row, int col);
-void SystemInfo(System& system, WINDOW* window, int& row, int col);
-void CpuBars(System& sys, WINDOW* win, int& row, int col);
-void MemoryBar(System& system, WINDOW* window, int& row, int col);
+void SystemInfo(System& system, const Snapshot& snapshot, WINDOW* window,
+                int& row, int col);
+void CpuBars(System& sys, const Snapshot& snap, const History& history,
+             WINDOW* win, int& row, int col);
+void MemoryBar(const Snapshot& snapshot, WINDOW* window, int& row, int col);
 void ProcessMenu(System& system, WINDOW* window, int& row, int col);
-void ProcessInfo(System& system, WINDOW* window, int& row, int col);
-void DisplaySystem(System& system, WINDOW* window);
-void DisplayProcesses(System& system, WINDOW* window, int n);
-void Display(System& system);
+void ProcessInfo(System& system, const Snapshot& snapshot, WINDOW* window,
+                 int& row, int col);
+void DisplaySystem(System& system, const Snapshot& snapshot,
+                   const History& history, WINDOW* window);
+void DisplayTimings(System& system, WINDOW* window);
+void DisplayProcesses(System& system, const Snapshot& snapshot,
+                      const std::vector<unsigned int>& order,
+                      const History& history, const Viewport& viewport,
+                      WINDOW* window, int n);
+void Display(System& system, SnapshotSource& source);
 };  // namespace NCursesDisplay
 
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <charconv>
+#include <string_view>
+#include <vector>
+
+/*
+Buffered writer for machine readable output
+Text and numbers are formatted straight into a fixed buffer, with
+std::to_chars for numbers, and written to the file descriptor with write()
+whenever the buffer fills up or Flush() is called. Nothing allocates after
+construction.
+*/
+class OutputBuffer {
+ public:
+  explicit OutputBuffer(int fd, size_t capacity = 1 << 16);
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+  ~OutputBuffer();
+  OutputBuffer& Append(std::string_view text);
+  OutputBuffer& Append(char c);
+  OutputBuffer& AppendFixed(double value, int precision);
+  OutputBuffer& AppendJson(std::string_view text);
+  OutputBuffer& AppendCsv(std::string_view text);
+  template <typename T>
+  OutputBuffer& AppendNumber(T value);
+  bool Flush();
+
+ private:
+  int fd_;
+  std::vector<char> buffer_;
+  size_t size_{0};
+  bool failed_{false};
+
+  char* Reserve(size_t n);
+};
+
+// wide enough for any integer type
+#define NUMBER_CHARS 24
+
+template <typename T>
+OutputBuffer& OutputBuffer::AppendNumber(T value) {
+  char* p = Reserve(NUMBER_CHARS);
+  size_ = std::to_chars(p, p + NUMBER_CHARS, value).ptr - buffer_.data();
+  return *this;
+}
+
+#endif
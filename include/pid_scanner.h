@@ -0,0 +1,34 @@
+#ifndef PID_SCANNER_H
+#define PID_SCANNER_H
+
+#include <string>
+#include <vector>
+
+/*
+Lists the pids in /proc
+The directory is opened once and read again from the start with getdents64()
+on every call to Scan(), into a buffer owned by the scanner. Entries are
+filtered by d_type and their names parsed in place, so a scan does not stat
+or allocate once the caller's pid vector has grown to size.
+*/
+class PidScanner {
+ public:
+  explicit PidScanner(std::string path);
+  PidScanner(const PidScanner&) = delete;
+  PidScanner& operator=(const PidScanner&) = delete;
+  ~PidScanner();
+  bool IsOpen() const;
+  void Scan(std::vector<unsigned int>& pids);
+  void Scan(const char* path, std::vector<unsigned int>& ids);
+
+ private:
+  std::string path_;
+  int fd_{-1};
+  std::vector<char> buffer_;
+
+  void Open();
+  void Close();
+  void ReadEntries(int fd, std::vector<unsigned int>& ids);
+};
+
+#endif
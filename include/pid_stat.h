@@ -0,0 +1,21 @@
+#ifndef PID_STAT_H
+#define PID_STAT_H
+
+/*
+Typed record of the /proc/[pid]/stat fields used by the monitor
+Filled by LinuxParser::ReadPidStat() from a single read of the file, using the
+LinuxParser::PidStat enum for the field indices.
+*/
+struct PidStat {
+  unsigned int pid{0};
+  char state{'\0'};
+  unsigned int ppid{0};
+  unsigned long minflt{0};
+  unsigned long majflt{0};
+  unsigned long utime{0};
+  unsigned long stime{0};
+  long threads{0};
+  unsigned long long starttime{0};
+};
+
+#endif
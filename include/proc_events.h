@@ -0,0 +1,42 @@
+#ifndef PROC_EVENTS_H
+#define PROC_EVENTS_H
+
+#include <vector>
+
+/*
+Process births and deaths reported by the kernel proc connector
+A netlink socket subscribed to the proc connector receives a FORK, EXEC and
+EXIT event for every process, which keeps a pid list up to date without
+scanning /proc. Subscribing needs CAP_NET_ADMIN, so IsOpen() is false for
+ordinary users and the caller has to fall back to scanning /proc.
+*/
+class ProcEvents {
+ public:
+  ProcEvents();
+  ProcEvents(const ProcEvents&) = delete;
+  ProcEvents& operator=(const ProcEvents&) = delete;
+  ~ProcEvents();
+  bool IsOpen() const;
+  bool Update(std::vector<unsigned int>& pids,
+              std::vector<unsigned int>& execs);
+  unsigned long ShortLived() const;
+
+ private:
+  enum Kind { kFork = 0, kExec, kExit };
+  struct Event {
+    unsigned int pid;
+    Kind kind;
+  };
+
+  int fd_{-1};
+  std::vector<char> buffer_;
+  std::vector<Event> events_;  // in the order they were received
+  std::vector<unsigned int> merged_;
+  unsigned long short_lived_{0};
+
+  void Open();
+  void Close();
+  bool Receive();
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef PROC_FILE_H
+#define PROC_FILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Kept-open handle for a system wide /proc file
+The file is opened once and re-read from offset 0 with pread() on every call
+to Read(), into a buffer owned by the handle. The view returned by Read()
+remains valid until the next call to Read().
+*/
+class ProcFile {
+ public:
+  explicit ProcFile(std::string path);
+  ProcFile(const ProcFile&) = delete;
+  ProcFile& operator=(const ProcFile&) = delete;
+  ProcFile(ProcFile&& other) noexcept;
+  ProcFile& operator=(ProcFile&& other) noexcept;
+  ~ProcFile();
+  const std::string& Path() const;
+  bool IsOpen() const;
+  std::string_view Read();
+
+ private:
+  std::string path_;
+  int fd_{-1};
+  std::vector<char> buffer_;
+
+  void Open();
+  void Close();
+};
+
+#endif
@@ -2,47 +2,74 @@
 #define PROCESS_H
 
 #include <string>
+
+#include "pid_stat.h"
+
 /*
 Basic class for Process representation
 It contains relevant attributes as shown below
 */
 class Process {
  public:
-  Process(unsigned int pid, std::string user, std::string command);
+  Process(unsigned int pid, std::string user, std::string command,
+          unsigned int tgid = 0);
   unsigned int Pid() const;
-  std::string User() const;
-  std::string Command(unsigned int len = 0) const;
+  unsigned int Tgid() const;
+  unsigned int PPid() const;
+  long Threads() const;
+  const std::string& User() const;
+  const std::string& Command() const;
+  std::string Command(unsigned int len) const;
   unsigned long Active() const;
   unsigned long UpTime() const;
+  unsigned long long StartTime() const;
   float CpuUtilization() const;
-  std::string Ram() const;
-  std::string State() const;
-  bool isKilled() const;
-  void Update();
+  unsigned long Ram() const;
+  bool RamRead() const;
+  char State() const;
+  unsigned long Generation() const;
+  bool Due(unsigned long generation) const;
+  bool isRecycled() const;
+  void MarkSeen(unsigned long generation);
+  void Update(double uptime, unsigned long generation, bool detail = true);
+  void UpdateUpTime(double uptime);
+  void Restore(char state, float cpu_util, unsigned long ram,
+               unsigned long uptime);
   bool operator<(Process const& a) const;
   bool operator==(unsigned int const& a) const;
   bool operator==(Process const& a) const;
 
  private:
   unsigned int pid_{0};
+  unsigned int tgid_{0};  // the process of a thread, 0 for a process
+  unsigned int ppid_{0};
   std::string user_;
   std::string command_;
   unsigned long active_{0};
   unsigned long uptime_{0};
+  unsigned long long starttime_{0};
+  double sampled_{0.0};  // system uptime when active_ was read
   float cpu_util_{0.0};
-  std::string ram_;
-  std::string state_;
-  bool killed_{false};
+  unsigned long ram_{0};  // resident set size in kB
+  bool ram_read_{false};  // ram_ has been read or restored at least once
+  char state_{' '};
+  long threads_{0};
+  unsigned long generation_{0};     // last tick the process was seen alive
+  unsigned long next_update_{0};    // tick the process is due to be read
+  unsigned int idle_ticks_{0};      // consecutive idle reads
+  bool recycled_{false};
 
   void SetActive(unsigned long active);
   void SetUpTime(unsigned long uptime);
   void SetCpuUtilization(float cpu_util);
-  void SetRam(std::string ram);
-  void SetState(std::string state);
-  void SetKilled(bool k);
-  void UpdateCpuUtilization();
+  void SetRam(unsigned long ram);
+  void SetState(char state);
+  void SetRecycled(bool r);
+  void UpdateCpuUtilization(const PidStat& stat, double uptime);
+  void UpdateSchedule(const PidStat& stat, unsigned long active,
+                      unsigned long generation);
   void UpdateRam();
-  void UpdateState();
+  void UpdateState(const PidStat& stat);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef PROCESS_SORTER_H
+#define PROCESS_SORTER_H
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "process.h"
+#include "process_tree.h"
+#include "system.h"
+
+/*
+Sort engine for a list of processes
+The processes are left in place, and only an index into them is sorted. One
+key is computed per process for every call to Sort(), and only the first
+`visible` entries of the index are guaranteed to be in order. Tree() instead
+lays the index out in the depth first order of the process tree.
+*/
+class ProcessSorter {
+ public:
+  const std::vector<unsigned int>& Sort(const std::vector<Process>& processes,
+                                        System::Sort_t sort, bool descending,
+                                        size_t visible = 0);
+  const std::vector<unsigned int>& Tree(
+      const std::vector<Process>& processes,
+      const std::vector<unsigned int>& tree_order,
+      const std::vector<TreeNode>& tree,
+      const std::vector<unsigned int>& collapsed);
+  const std::vector<unsigned int>& Order() const;
+
+ private:
+  std::vector<unsigned int> order_;  // indexes into the processes, sorted
+  std::vector<std::pair<double, unsigned int>> numeric_keys_;
+  std::vector<std::pair<std::string_view, unsigned int>> text_keys_;
+
+  template <typename Key, typename Extract>
+  void SortBy(const std::vector<Process>& processes, std::vector<Key>& keys,
+              bool descending, size_t visible, Extract extract);
+};
+
+#endif
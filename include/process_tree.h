@@ -0,0 +1,58 @@
+#ifndef PROCESS_TREE_H
+#define PROCESS_TREE_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "process.h"
+
+/*
+Place of a process in the tree view, and the totals of its subtree
+cpu and ram include the process itself. The descendants of a process follow
+it in the depth first order, so hiding them skips that many entries.
+*/
+struct TreeNode {
+  unsigned int depth{0};
+  unsigned int descendants{0};
+  float cpu{0.0};
+  unsigned long ram{0};  // kB
+};
+
+/*
+Parent and child links between processes, kept from one tick to the next
+Only processes that appeared, exited or changed parent are relinked, so
+keeping the tree costs one lookup per process per tick. The links are held in
+a vector of slots that refer to each other by slot, so walking the tree does
+not hash, and the children of a process are kept in pid order.
+*/
+class ProcessTree {
+ public:
+  ProcessTree();
+  void Clear();
+  void Remove(const std::vector<Process>& exited);
+  void Update(const std::vector<Process>& processes);
+  void Flatten(const std::vector<Process>& processes,
+               std::vector<unsigned int>& order,
+               std::vector<TreeNode>& nodes) const;
+
+ private:
+  struct Link {
+    unsigned int pid{0};
+    unsigned int ppid{0};   // the parent pid the process was linked under
+    unsigned int index{0};  // in the processes given to the last Update()
+    int parent{-1};
+    int first_child{-1};
+    int last_child{-1};
+    int prev{-1};
+    int next{-1};
+  };
+  std::vector<Link> links_;  // slot 0 is the root above every process
+  std::vector<int> free_;    // slots of exited processes, for reuse
+  std::unordered_map<unsigned int, int> slots_;  // by pid
+  std::vector<int> relink_;  // slots whose parent changed in Update()
+
+  void Attach(int slot, int parent);
+  void Detach(int slot);
+};
+
+#endif
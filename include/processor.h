@@ -1,15 +1,18 @@
 #ifndef PROCESSOR_H
 #define PROCESSOR_H
 
+#include "stat_snapshot.h"
+
 class Processor {
  public:
   Processor();
   Processor(int id);
+  Processor(int id, float cpu_util);
   int Id() const;
   unsigned long Jiffies() const;
   unsigned long IdleJiffies() const;
   float Utilization() const;
-  void Update();
+  void Update(const StatSnapshot& stat);
 
  private:
   int id_;
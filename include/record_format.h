@@ -0,0 +1,66 @@
+#ifndef RECORD_FORMAT_H
+#define RECORD_FORMAT_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/*
+Binary layout shared by the Recorder and the Replayer
+
+A recording starts with kMagic, the kernel and operating system strings, the
+number of cpus and whether the proc connector was in use. Records follow,
+each a type byte, a varint payload length and the payload:
+
+  kString    the bytes of the next interned string, numbered from 0
+  kKeyframe  a tick, with every process encoded against an empty state
+  kDelta     a tick, with every process encoded against the previous tick
+
+A tick holds the tick number, the wall clock time in ms, the uptime, the
+memory and cpu utilizations, the total, running and short-lived process
+counts, then the processes sorted by pid. A process is its pid as a delta from
+the previous pid, a byte of kField flags and the fields that changed. Ram and
+uptime are stored as zigzag deltas, utilizations as fixed point fractions of
+kScale. All numbers are LEB128 varints.
+*/
+namespace RecordFormat {
+const std::string_view kMagic{"MONREC1\n"};
+
+enum Record_t : unsigned char {
+  kString = 'S',
+  kKeyframe = 'K',
+  kDelta = 'D',
+};
+
+enum Field_t : unsigned char {
+  kUser = 1 << 0,
+  kCommand = 1 << 1,
+  kState = 1 << 2,
+  kCpu = 1 << 3,
+  kRam = 1 << 4,
+  kUpTime = 1 << 5,
+};
+
+const double kScale{10000.0};
+
+// the recorded fields of one process
+struct Entry {
+  unsigned int pid{0};
+  uint32_t user{0};     // interned string id
+  uint32_t command{0};  // interned string id
+  char state{' '};
+  uint32_t cpu{0};  // scaled by kScale
+  uint64_t ram{0};  // kB
+  uint64_t uptime{0};
+};
+
+uint32_t Quantize(float fraction);
+void PutVarint(std::vector<char>& out, uint64_t value);
+void PutZigzag(std::vector<char>& out, int64_t value);
+void PutString(std::vector<char>& out, std::string_view text);
+bool GetVarint(std::string_view& in, uint64_t& value);
+bool GetZigzag(std::string_view& in, int64_t& value);
+bool GetString(std::string_view& in, std::string_view& text);
+};  // namespace RecordFormat
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "output_buffer.h"
+#include "record_format.h"
+#include "snapshot.h"
+#include "system.h"
+
+/*
+Writes snapshots to a recording file, one record per tick
+Every tick is encoded as a delta from the previous one, with a keyframe every
+KEYFRAME_INTERVAL ticks so a Replayer can seek without decoding from the
+start. Users and commands are interned, so each string is written only once.
+The file is flushed after every tick, so a recording cut short by a crash
+stays readable up to its last tick. See record_format.h for the layout.
+*/
+class Recorder {
+ public:
+  Recorder(const std::string& path, const System& system);
+  Recorder(const Recorder&) = delete;
+  Recorder& operator=(const Recorder&) = delete;
+  ~Recorder();
+  bool IsOpen() const;
+  void Write(const Snapshot& snapshot);
+
+ private:
+  int fd_{-1};
+  OutputBuffer out_;
+  std::unordered_map<std::string, uint32_t> strings_;
+  std::vector<char> records_;  // string records for the current tick
+  std::vector<char> frame_;    // payload of the current tick
+  std::vector<RecordFormat::Entry> previous_;
+  std::vector<RecordFormat::Entry> current_;
+  unsigned long frames_{0};
+
+  uint32_t Intern(const std::string& text);
+  void Encode(const RecordFormat::Entry& entry,
+              const RecordFormat::Entry& base, unsigned int last_pid);
+  void Flush(RecordFormat::Record_t type);
+};
+
+#endif
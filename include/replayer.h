@@ -0,0 +1,77 @@
+#ifndef REPLAYER_H
+#define REPLAYER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "record_format.h"
+#include "snapshot.h"
+#include "snapshot_source.h"
+
+/*
+Publishes the ticks of a recording made by a Recorder
+The file is mapped read only. Opening it walks the record headers once to
+collect the interned strings and build a seek index of every tick and the
+keyframe it depends on, so a seek decodes at most one keyframe interval.
+Ticks are published at their recorded pace times the playback speed, from a
+timerfd that the display polls, so no thread is needed.
+*/
+class Replayer : public SnapshotSource {
+ public:
+  Replayer(const std::string& path, double speed = 1.0);
+  Replayer(const Replayer&) = delete;
+  Replayer& operator=(const Replayer&) = delete;
+  ~Replayer();
+  bool IsOpen() const;
+  const std::string& Kernel() const;
+  const std::string& OperatingSystem() const;
+  int TotalCpus() const;
+  double Duration() const;
+  void Seek(double seconds);
+  void Start() override;
+  void Stop() override;
+  std::shared_ptr<const Snapshot> Latest() const override;
+  int ReadyFd() const override;
+  void ClearReady() override;
+  bool Key(int key) override;
+
+ private:
+  struct Frame {
+    uint64_t time;        // wall clock time in ms
+    uint64_t offset;      // ms since the first tick, for pacing and seeking
+    std::string_view payload;
+    size_t keyframe;      // index of the keyframe this tick depends on
+  };
+
+  const char* data_{nullptr};
+  size_t size_{0};
+  int timer_fd_{-1};
+  std::string kernel_;
+  std::string os_;
+  int total_cpus_{0};
+  bool events_{false};
+  std::vector<std::string_view> strings_;
+  std::vector<Frame> frames_;
+  double speed_;
+  bool paused_{false};
+  bool started_{false};
+  size_t position_{0};  // index of the tick in current_
+  bool decoded_{false};
+  std::vector<RecordFormat::Entry> previous_;
+  std::vector<RecordFormat::Entry> current_;
+  std::vector<RecordFormat::Entry> exited_;
+  std::shared_ptr<Snapshot> buffers_[2];
+  int back_{0};
+  std::shared_ptr<const Snapshot> latest_;
+
+  bool Index();
+  bool Decode(size_t frame, Snapshot& snapshot);
+  void Show(size_t frame);
+  void Arm();
+  std::string String(uint32_t id) const;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ROW_CACHE_H
+#define ROW_CACHE_H
+
+#include <curses.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Text drawn on each row of a window by the previous frame
+Draw() compares a row with what was drawn there last, and only writes the
+spans that changed, so an unchanged row does not touch the window at all and
+ncurses has nothing to send for it. A row whose attributes changed, such as
+a row that was selected or deselected, is written in full. Anything else
+that writes over the cached rows, such as werase(), must be followed by
+Invalidate().
+*/
+class RowCache {
+ public:
+  void Invalidate();
+  void Draw(WINDOW* window, int row, int col, std::string_view text,
+            attr_t attributes = A_NORMAL);
+
+ private:
+  std::vector<std::string> rows_;
+  std::vector<attr_t> attributes_;
+};
+
+#endif
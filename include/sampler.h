@@ -0,0 +1,52 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "recorder.h"
+#include "snapshot.h"
+#include "snapshot_source.h"
+#include "system.h"
+
+/*
+Background thread sampling a System at a fixed interval
+Ticks come from a periodic timerfd, so the cadence does not drift by the time
+spent sampling. Each tick fills one of two Snapshot buffers and publishes it
+with an atomic shared_ptr swap, then makes ReadyFd() readable. A buffer is
+only refilled once the display has let go of it, otherwise a new one is
+allocated in its place. With a Recorder set, every published snapshot is also
+recorded, on the sampling thread.
+*/
+class Sampler : public SnapshotSource {
+ public:
+  Sampler(System& system, std::chrono::milliseconds interval);
+  Sampler(const Sampler&) = delete;
+  Sampler& operator=(const Sampler&) = delete;
+  ~Sampler();
+  void SetRecorder(Recorder* recorder);
+  void Start() override;
+  void Stop() override;
+  std::shared_ptr<const Snapshot> Latest() const override;
+  int ReadyFd() const override;
+  void ClearReady() override;
+
+ private:
+  System& system_;
+  std::chrono::milliseconds interval_;
+  Recorder* recorder_{nullptr};
+  std::thread thread_;
+  int timer_fd_{-1};
+  int stop_fd_{-1};
+  int ready_fd_{-1};
+  std::shared_ptr<Snapshot> buffers_[2];
+  int back_{0};
+  unsigned long ticks_{0};
+  std::shared_ptr<const Snapshot> latest_;  // accessed with std::atomic_*
+
+  void Loop();
+  void Sample();
+};
+
+#endif
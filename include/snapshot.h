@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+
+#include "process.h"
+#include "process_tree.h"
+#include "processor.h"
+
+/*
+Everything the display needs from one sampling tick
+A Snapshot is filled by the Sampler thread and never modified once it has
+been published, so the display can read it without locking.
+*/
+struct Snapshot {
+  unsigned long tick{0};
+  std::vector<Process> processes;
+  std::vector<Process> exited;  // exited during this tick
+  // threads of the processes near the screen, sorted by process and thread id,
+  // when the display shows threads
+  std::vector<Process> threads;
+  // when the display shows the tree, the processes in depth first order, and
+  // the place of each process in the tree, by index in processes
+  std::vector<unsigned int> tree_order;
+  std::vector<TreeNode> tree;
+  Processor cpu;
+  std::vector<Processor> cpus;
+  float memory{0.0};
+  unsigned long uptime{0};
+  unsigned long total_processes{0};
+  unsigned long running_processes{0};
+  unsigned long short_lived{0};  // since the start, with the proc connector
+  bool process_events{false};    // whether short_lived is counted
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SNAPSHOT_SOURCE_H
+#define SNAPSHOT_SOURCE_H
+
+#include <memory>
+
+#include "snapshot.h"
+
+/*
+Something that publishes Snapshots for a display to show
+A display polls ReadyFd(), calls ClearReady() once it is readable, and then
+shows Latest(). The Sampler publishes live samples, the Replayer the ticks of
+a recording.
+*/
+class SnapshotSource {
+ public:
+  virtual ~SnapshotSource() = default;
+  virtual void Start() = 0;
+  virtual void Stop() = 0;
+  virtual std::shared_ptr<const Snapshot> Latest() const = 0;
+  virtual int ReadyFd() const = 0;
+  virtual void ClearReady() = 0;
+  // handles a key the display does not use, returns whether it was used
+  virtual bool Key(int) { return false; }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef STAT_SNAPSHOT_H
+#define STAT_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+#include "proc_file.h"
+
+/*
+Single pass snapshot of /proc/stat
+Every cpu line is parsed into a flat array holding kFields jiffy counters per
+cpu, with the aggregate cpu stored first. Cpu indexes follow the Processor
+convention: -1 is the aggregate cpu, and N is the line keyed "cpuN".
+*/
+class StatSnapshot {
+ public:
+  static constexpr int kFields = 10;  // user through guest_nice
+
+  StatSnapshot();
+  explicit StatSnapshot(std::string path);
+  void Update();
+  int TotalCpus() const;
+  unsigned long Jiffies(int index = -1) const;
+  unsigned long ActiveJiffies(int index = -1) const;
+  unsigned long IdleJiffies(int index = -1) const;
+  unsigned long TotalProcesses() const;
+  unsigned long RunningProcesses() const;
+  unsigned long ContextSwitches() const;
+  unsigned long Interrupts() const;
+
+ private:
+  ProcFile file_;
+  int total_cpus_{0};
+  std::vector<unsigned long> cpus_;
+  unsigned long processes_{0};
+  unsigned long procs_running_{0};
+  unsigned long ctxt_{0};
+  unsigned long intr_{0};
+
+  unsigned long Value(int index, int state) const;
+};
+
+#endif
@@ -1,18 +1,34 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "instrumentation.h"
+#include "proc_events.h"
+#include "pid_scanner.h"
+#include "proc_file.h"
 #include "process.h"
+#include "process_tree.h"
 #include "processor.h"
+#include "stat_snapshot.h"
+#include "user_cache.h"
+#include "worker_pool.h"
 
 class System {
  public:
   enum Sort_t { kPid_ = 0, kUser_, kState_, kCpu_, kRam_, kUpTime_, kCommand_ };
 
-  System();
+  explicit System(size_t workers = 0, bool events = true);
+  System(std::string kernel, std::string os, int total_cpus);
   std::vector<Process>& Processes();
+  const std::vector<Process>& Exited() const;
+  const std::vector<Process>& Threads() const;
+  const std::vector<unsigned int>& TreeOrder() const;
+  const std::vector<TreeNode>& Tree() const;
   int TotalCpus() const;
   Processor& Cpu();
   std::vector<Processor>& Cpus();
@@ -21,30 +37,76 @@ class System {
   unsigned long RunningProcesses() const;
   unsigned long TotalProcesses() const;
   unsigned long UpTime() const;
+  bool ProcessEvents() const;
+  unsigned long ShortLived() const;
   float MemoryUtilization() const;
   bool ShowCores() const;
   void ToggleCores();
+  bool ShowTimings() const;
+  void ToggleTimings();
+  bool ShowThreads() const;
+  void ToggleThreads();
+  bool ShowTree() const;
+  void ToggleTree();
+  bool ShowHistory() const;
+  void ToggleHistory();
   Sort_t Sort() const;
   void SetSort(Sort_t s);
   bool Descending() const;
   void SetDescending(bool d);
+  void SetVisiblePids(const std::vector<unsigned int>& pids);
+  void SetFullDetail(bool full);
+  Instrumentation& Timings();
   void UpdateProcessors();
   void UpdateProcesses();
 
  private:
   int total_cpus_;
+  StatSnapshot stat_;
+  // kept open for the life of the System, and re-read from const accessors
+  mutable ProcFile meminfo_file_;
+  mutable ProcFile uptime_file_;
+  UserCache users_;
+  PidScanner pid_scanner_;
+  std::unique_ptr<ProcEvents> events_;  // null when scanning /proc
+  WorkerPool pool_;
+  // per worker list of processes whose pid was reused, filled in parallel
+  std::vector<std::vector<unsigned int>> recycled_;
   Processor aggregate_cpu_;
   std::vector<Processor> cpus_;
-  std::vector<Process> processes_;
+  std::vector<Process> processes_;        // sorted by pid
+  std::vector<Process> exited_;           // exited during the last tick
+  std::vector<Process> threads_;          // sorted by process, then thread
+  std::vector<Process> next_threads_;     // threads_ being rebuilt
+  std::vector<unsigned int> tids_;        // threads of one process
+  ProcessTree tree_;                      // kept while the tree is shown
+  std::vector<unsigned int> tree_order_;  // processes_ depth first
+  std::vector<TreeNode> tree_nodes_;      // by index in processes_
+  std::vector<unsigned int> pids_;        // sorted pids alive this tick
+  std::vector<unsigned int> execs_;       // sorted pids that called exec
+  std::vector<unsigned int> visible_;     // sorted pids read in detail
+  bool detailed_{false};  // every process was read in detail last tick
+  unsigned long generation_{0};           // incremented every tick
   std::string kernel_;
   std::string os_;
-  bool show_cores_ = true;
-  Sort_t sort_ = kCpu_;
-  bool descending_ = true;
+  // display settings, changed by the display while a Sampler is running
+  std::atomic<bool> show_cores_{true};
+  std::atomic<bool> show_timings_{false};
+  std::atomic<bool> show_threads_{false};
+  std::atomic<bool> show_tree_{false};
+  std::atomic<bool> show_history_{false};
+  std::atomic<Sort_t> sort_{kCpu_};
+  std::atomic<bool> descending_{true};
+  std::atomic<bool> full_detail_{false};
+  std::mutex visible_mutex_;
+  std::vector<unsigned int> visible_pids_;  // guarded by visible_mutex_
+  Instrumentation timings_;
 
+  Process NewProcess(unsigned int pid);
   void AddProcesses();
   void RemoveProcesses();
-  void SortProcesses();
+  void UpdateThreads(double uptime);
+  void UpdateTree();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef USER_CACHE_H
+#define USER_CACHE_H
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+
+/*
+Cache of user names keyed by numeric uid
+/etc/passwd is parsed once, and parsed again only when Refresh() finds that
+its modification time has changed. Uids missing from the file (LDAP, NIS, ...)
+are resolved once with getpwuid_r() and kept until the next reload.
+*/
+class UserCache {
+ public:
+  explicit UserCache(std::string path);
+  void Refresh();
+  std::string Name(unsigned int uid);
+
+ private:
+  std::string path_;
+  struct timespec mtime_{};
+  std::unordered_map<unsigned int, std::string> names_;
+
+  void Load();
+};
+
+#endif
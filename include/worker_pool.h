@@ -0,0 +1,57 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Fixed pool of worker threads for data parallel loops
+Run() splits [0, count) into one contiguous range per worker. Each worker
+takes chunks from the front of its own range, and once that is empty, steals
+chunks from the ranges of the other workers. Chunks are claimed with a single
+atomic increment, so no lock is taken while work is in progress. The calling
+thread takes part as worker 0.
+*/
+class WorkerPool {
+ public:
+  // task(worker, begin, end) processes the items in [begin, end)
+  using Task = std::function<void(size_t, size_t, size_t)>;
+
+  explicit WorkerPool(size_t size = 0);
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+  ~WorkerPool();
+  size_t Size() const;
+  void Run(size_t count, size_t chunk, const Task& task);
+  static size_t DefaultSize();
+  static size_t MaxSize();
+
+ private:
+  struct alignas(64) Range {
+    std::atomic<size_t> next{0};
+    size_t end{0};
+  };
+
+  size_t size_;
+  std::unique_ptr<Range[]> ranges_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const Task* task_{nullptr};
+  size_t chunk_{1};
+  unsigned long job_{0};
+  size_t busy_{0};
+  bool stop_{false};
+
+  void Loop(size_t worker);
+  void Work(size_t worker);
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "batch_display.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "instrumentation.h"
+#include "output_buffer.h"
+#include "process_sorter.h"
+#include "snapshot.h"
+#include "snapshot_source.h"
+#include "system.h"
+
+using std::vector;
+
+void BatchDisplay::CsvHeader(OutputBuffer& out) {
+  out.Append(
+      "time,tick,uptime,cpu,memory,running_processes,total_processes,"
+      "alive_processes,exited,short_lived,pid,user,state,process_cpu,ram_kb,"
+      "process_uptime,command");
+  for (int phase = 0; phase < Instrumentation::kTotalPhases_; phase++) {
+    const std::string& name =
+        Instrumentation::Name((Instrumentation::Phase_t)phase);
+    out.Append(',').Append(name).Append("_p50_ms,");
+    out.Append(name).Append("_p99_ms");
+  }
+  out.Append(",self_cpu,self_ram_kb\n");
+}
+
+/*
+ * One row per process among the first n of order, each carrying the system
+ * metrics of the tick and the monitor's own timings, so every row stands on
+ * its own in a log pipeline.
+ */
+void BatchDisplay::Csv(OutputBuffer& out, const Snapshot& snapshot,
+                       double time, const vector<unsigned int>& order,
+                       size_t n, const Instrumentation& timings) {
+  Instrumentation::Summary summaries[Instrumentation::kTotalPhases_];
+  for (int phase = 0; phase < Instrumentation::kTotalPhases_; phase++) {
+    summaries[phase] =
+        timings.Percentiles((Instrumentation::Phase_t)phase);
+  }
+  for (size_t i = 0; i < n && i < order.size(); i++) {
+    const Process& process = snapshot.processes[order[i]];
+    out.AppendFixed(time, 3).Append(',');
+    out.AppendNumber(snapshot.tick).Append(',');
+    out.AppendNumber(snapshot.uptime).Append(',');
+    out.AppendFixed(snapshot.cpu.Utilization(), 4).Append(',');
+    out.AppendFixed(snapshot.memory, 4).Append(',');
+    out.AppendNumber(snapshot.running_processes).Append(',');
+    out.AppendNumber(snapshot.total_processes).Append(',');
+    out.AppendNumber(snapshot.processes.size()).Append(',');
+    out.AppendNumber(snapshot.exited.size()).Append(',');
+    out.AppendNumber(snapshot.short_lived).Append(',');
+    out.AppendNumber(process.Pid()).Append(',');
+    out.AppendCsv(process.User()).Append(',');
+    out.Append(process.State()).Append(',');
+    out.AppendFixed(process.CpuUtilization(), 4).Append(',');
+    out.AppendNumber(process.Ram()).Append(',');
+    out.AppendNumber(process.UpTime()).Append(',');
+    out.AppendCsv(process.Command());
+    for (const Instrumentation::Summary& summary : summaries) {
+      out.Append(',').AppendFixed(summary.p50, 3);
+      out.Append(',').AppendFixed(summary.p99, 3);
+    }
+    out.Append(',').AppendFixed(timings.SelfCpu(), 4);
+    out.Append(',').AppendNumber(timings.SelfRam()).Append('\n');
+  }
+}
+
+/*
+ * One JSON object per tick, holding the system metrics, the monitor's own
+ * timings and the first n processes of order.
+ */
+void BatchDisplay::Jsonl(OutputBuffer& out, const Snapshot& snapshot,
+                         double time, const vector<unsigned int>& order,
+                         size_t n, const Instrumentation& timings) {
+  out.Append("{\"time\":").AppendFixed(time, 3);
+  out.Append(",\"tick\":").AppendNumber(snapshot.tick);
+  out.Append(",\"uptime\":").AppendNumber(snapshot.uptime);
+  out.Append(",\"cpu\":").AppendFixed(snapshot.cpu.Utilization(), 4);
+  out.Append(",\"cpus\":[");
+  for (size_t i = 0; i < snapshot.cpus.size(); i++) {
+    if (i > 0) {
+      out.Append(',');
+    }
+    out.AppendFixed(snapshot.cpus[i].Utilization(), 4);
+  }
+  out.Append("],\"memory\":").AppendFixed(snapshot.memory, 4);
+  out.Append(",\"running_processes\":")
+      .AppendNumber(snapshot.running_processes);
+  out.Append(",\"total_processes\":").AppendNumber(snapshot.total_processes);
+  out.Append(",\"alive_processes\":").AppendNumber(snapshot.processes.size());
+  out.Append(",\"exited\":").AppendNumber(snapshot.exited.size());
+  out.Append(",\"short_lived\":").AppendNumber(snapshot.short_lived);
+  out.Append(",\"timings_ms\":{");
+  for (int phase = 0; phase < Instrumentation::kTotalPhases_; phase++) {
+    Instrumentation::Summary summary =
+        timings.Percentiles((Instrumentation::Phase_t)phase);
+    if (phase > 0) {
+      out.Append(',');
+    }
+    out.Append('"')
+        .Append(Instrumentation::Name((Instrumentation::Phase_t)phase))
+        .Append("\":{\"p50\":")
+        .AppendFixed(summary.p50, 3);
+    out.Append(",\"p99\":").AppendFixed(summary.p99, 3).Append('}');
+  }
+  out.Append("},\"self_cpu\":").AppendFixed(timings.SelfCpu(), 4);
+  out.Append(",\"self_ram_kb\":").AppendNumber(timings.SelfRam());
+  out.Append(",\"processes\":[");
+  for (size_t i = 0; i < n && i < order.size(); i++) {
+    const Process& process = snapshot.processes[order[i]];
+    if (i > 0) {
+      out.Append(',');
+    }
+    out.Append("{\"pid\":").AppendNumber(process.Pid());
+    out.Append(",\"user\":").AppendJson(process.User());
+    out.Append(",\"state\":\"").Append(process.State()).Append('"');
+    out.Append(",\"cpu\":").AppendFixed(process.CpuUtilization(), 4);
+    out.Append(",\"ram_kb\":").AppendNumber(process.Ram());
+    out.Append(",\"uptime\":").AppendNumber(process.UpTime());
+    out.Append(",\"command\":").AppendJson(process.Command()).Append('}');
+  }
+  out.Append("]}\n");
+}
+
+/*
+ * Writes one record per tick to stdout until iterations ticks have been
+ * written, or forever if iterations is 0. top limits the processes written
+ * per tick to the first ones in the current sort order, 0 writes them all.
+ * Returns the exit status for main().
+ */
+int BatchDisplay::Display(System& system, SnapshotSource& source,
+                          unsigned long iterations, Format_t format,
+                          size_t top) {
+  OutputBuffer out(STDOUT_FILENO);
+  if (format == kCsv_) {
+    CsvHeader(out);
+  }
+  // Any process can enter the listed ones from one tick to the next, and a
+  // record must not report a RAM that was never read, so every process is
+  // read in full, from the first sample on.
+  system.SetFullDetail(true);
+  source.Start();
+  ProcessSorter sorter;
+  Instrumentation& timings = system.Timings();
+  vector<unsigned int> listed;
+  struct pollfd ready = {source.ReadyFd(), POLLIN, 0};
+  bool ok = true;
+  unsigned long written = 0;
+  while (ok && (iterations == 0 || written < iterations)) {
+    if (poll(&ready, 1, -1) < 0) {
+      continue;
+    }
+    source.ClearReady();
+    std::shared_ptr<const Snapshot> snapshot = source.Latest();
+    size_t n = top == 0 ? snapshot->processes.size() : top;
+    {
+      ScopedTimer timer(timings, Instrumentation::kSort_);
+      sorter.Sort(snapshot->processes, system.Sort(), system.Descending(), n);
+      // the listed processes are sampled every tick, however idle they are
+      listed.clear();
+      for (size_t j = 0; j < n && j < sorter.Order().size(); j++) {
+        listed.emplace_back(snapshot->processes[sorter.Order()[j]].Pid());
+      }
+      system.SetVisiblePids(listed);
+    }
+    double time = std::chrono::duration<double>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    // a record holds the timings up to the previous one
+    timings.UpdateSelf();
+    {
+      ScopedTimer timer(timings, Instrumentation::kRender_);
+      if (format == kCsv_) {
+        Csv(out, *snapshot, time, sorter.Order(), n, timings);
+      } else {
+        Jsonl(out, *snapshot, time, sorter.Order(), n, timings);
+      }
+    }
+    {
+      ScopedTimer timer(timings, Instrumentation::kRefresh_);
+      ok = out.Flush();
+    }
+    timings.EndTick(Instrumentation::kSort_, Instrumentation::kRefresh_);
+    written++;
+  }
+  source.Stop();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+#include "history.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "process.h"
+#include "processor.h"
+
+using std::vector;
+
+#define RAM_STEPS 2048.0  // quantization steps per doubling of the RAM
+
+namespace {
+uint8_t EncodeCpu(float utilization) {
+  return (uint8_t)std::lround(std::clamp(utilization, 0.0f, 1.0f) * 255);
+}
+
+// a share of every cpu, so a process using all of them still fits
+uint16_t EncodeProcessCpu(float utilization, int cpus) {
+  return (uint16_t)std::lround(
+      std::clamp(utilization / cpus, 0.0f, 1.0f) * 65535);
+}
+
+uint16_t EncodeRam(unsigned long ram) {
+  return (uint16_t)std::min(65535L,
+                            std::lround(std::log2(ram + 1.0) * RAM_STEPS));
+}
+}  // namespace
+
+/*
+ * cpus is the number of cpus whose utilization will be added, besides the
+ * aggregate.
+ */
+History::History(int cpus)
+    : cpus_(std::max(cpus, 1)),
+      series_(std::max(cpus, 0) + 1),
+      cpu_(series_ * HISTORY_SAMPLES),
+      pids_(HISTORY_PROCESSES),
+      starts_(HISTORY_PROCESSES),
+      used_(HISTORY_PROCESSES),
+      heads_(HISTORY_PROCESSES),
+      counts_(HISTORY_PROCESSES),
+      process_cpu_(HISTORY_PROCESSES * HISTORY_SAMPLES),
+      process_ram_(HISTORY_PROCESSES * HISTORY_SAMPLES) {}
+
+/*
+ * Adds a sample of the aggregate and of each cpu, and starts a new tick for
+ * the processes added after it. cpus beyond those given to the constructor
+ * are ignored.
+ */
+void History::AddCpus(const Processor& cpu, const vector<Processor>& cpus) {
+  tick_++;
+  cpu_[cpu_head_] = EncodeCpu(cpu.Utilization());
+  for (size_t i = 0; i + 1 < series_; i++) {
+    cpu_[(i + 1) * HISTORY_SAMPLES + cpu_head_] =
+        i < cpus.size() ? EncodeCpu(cpus[i].Utilization()) : 0;
+  }
+  cpu_head_ = (cpu_head_ + 1) % HISTORY_SAMPLES;
+  cpu_count_ = std::min(cpu_count_ + 1, (size_t)HISTORY_SAMPLES);
+}
+
+// the slot holding process, or -1. A reused pid does not match its slot.
+int History::Find(const Process& process) const {
+  for (int slot = 0; slot < HISTORY_PROCESSES; slot++) {
+    if (used_[slot] != 0 && pids_[slot] == process.Pid()) {
+      return starts_[slot] == process.StartTime() ? slot : -1;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Adds a sample of process, at most once per tick. The slots are scanned
+ * linearly, as there are few of them and the pids sit in one small array.
+ */
+void History::AddProcess(const Process& process) {
+  int slot = -1;
+  int oldest = 0;
+  for (int i = 0; i < HISTORY_PROCESSES; i++) {
+    if (used_[i] != 0 && pids_[i] == process.Pid()) {
+      slot = i;
+      break;
+    }
+    if (used_[i] < used_[oldest]) {
+      oldest = i;
+    }
+  }
+  if (slot >= 0 && used_[slot] == tick_) {
+    return;
+  }
+  if (slot < 0 || starts_[slot] != process.StartTime()) {
+    slot = slot < 0 ? oldest : slot;
+    pids_[slot] = process.Pid();
+    starts_[slot] = process.StartTime();
+    heads_[slot] = 0;
+    counts_[slot] = 0;
+  }
+  used_[slot] = tick_;
+  size_t at = (size_t)slot * HISTORY_SAMPLES + heads_[slot];
+  process_cpu_[at] = EncodeProcessCpu(process.CpuUtilization(), cpus_);
+  process_ram_[at] = EncodeRam(process.Ram());
+  heads_[slot] = (heads_[slot] + 1) % HISTORY_SAMPLES;
+  counts_[slot] = std::min(counts_[slot] + 1, HISTORY_SAMPLES);
+}
+
+/*
+ * Replaces samples with the last n values of ring, or fewer if fewer were
+ * added, oldest first. head is the position the next value goes to.
+ */
+template <typename T, typename Decode>
+void History::Read(const T* ring, size_t head, size_t count, size_t n,
+                   vector<float>& samples, Decode decode) {
+  samples.clear();
+  size_t m = std::min(n, count);
+  size_t start = head + HISTORY_SAMPLES - m;
+  for (size_t i = 0; i < m; i++) {
+    samples.emplace_back(decode(ring[(start + i) % HISTORY_SAMPLES]));
+  }
+}
+
+// series 0 is the aggregate and series i + 1 is cpu i, as utilization in [0, 1]
+void History::Cpu(int series, size_t n, vector<float>& samples) const {
+  if (series < 0 || (size_t)series >= series_) {
+    samples.clear();
+    return;
+  }
+  Read(&cpu_[series * HISTORY_SAMPLES], cpu_head_, cpu_count_, n, samples,
+       [](uint8_t q) { return q / 255.0f; });
+}
+
+// CPU% as a share of one cpu, as Process::CpuUtilization() is
+void History::ProcessCpu(const Process& process, size_t n,
+                         vector<float>& samples) const {
+  int slot = Find(process);
+  if (slot < 0) {
+    samples.clear();
+    return;
+  }
+  int cpus = cpus_;
+  Read(&process_cpu_[(size_t)slot * HISTORY_SAMPLES], heads_[slot],
+       counts_[slot], n, samples,
+       [cpus](uint16_t q) { return q / 65535.0f * cpus; });
+}
+
+// RAM in kB
+void History::ProcessRam(const Process& process, size_t n,
+                         vector<float>& samples) const {
+  int slot = Find(process);
+  if (slot < 0) {
+    samples.clear();
+    return;
+  }
+  Read(&process_ram_[(size_t)slot * HISTORY_SAMPLES], heads_[slot],
+       counts_[slot], n, samples,
+       [](uint16_t q) { return std::exp2(q / RAM_STEPS) - 1.0f; });
+}
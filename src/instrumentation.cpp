@@ -0,0 +1,113 @@
+#include "instrumentation.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "linux_parser.h"
+
+using std::string;
+
+const string& Instrumentation::Name(Phase_t phase) {
+  static const string names[kTotalPhases_] = {"scan",   "parse",  "reconcile",
+                                              "sort",   "render", "refresh"};
+  return names[phase];
+}
+
+void Instrumentation::Add(Phase_t phase,
+                          std::chrono::steady_clock::duration time) {
+  phases_[phase].pending.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(time).count(),
+      std::memory_order_relaxed);
+}
+
+/*
+ * Stores the time added to each phase in [first, last] since the last call as
+ * the total of one tick, including a phase that was not entered at all.
+ */
+void Instrumentation::EndTick(Phase_t first, Phase_t last) {
+  for (int phase = first; phase <= last; phase++) {
+    Ring& ring = phases_[phase];
+    uint64_t count = ring.count.load(std::memory_order_relaxed);
+    ring.samples[count % TIMING_WINDOW].store(
+        ring.pending.exchange(0, std::memory_order_relaxed),
+        std::memory_order_relaxed);
+    ring.count.store(count + 1, std::memory_order_release);
+  }
+}
+
+/*
+ * Takes the median and the 99th percentile of the ticks in the window. A
+ * sample being replaced while it is copied is read either as the old or the
+ * new value, both of which are recent.
+ */
+Instrumentation::Summary Instrumentation::Percentiles(Phase_t phase) const {
+  const Ring& ring = phases_[phase];
+  size_t n = std::min(ring.count.load(std::memory_order_acquire),
+                      (uint64_t)TIMING_WINDOW);
+  Summary summary;
+  if (n == 0) {
+    return summary;
+  }
+  uint64_t samples[TIMING_WINDOW];
+  for (size_t i = 0; i < n; i++) {
+    samples[i] = ring.samples[i].load(std::memory_order_relaxed);
+  }
+  size_t p50 = (n - 1) / 2;
+  size_t p99 = (n - 1) * 99 / 100;
+  std::nth_element(samples, samples + p99, samples + n);
+  summary.p99 = samples[p99] / 1e6;
+  std::nth_element(samples, samples + p50, samples + p99);
+  summary.p50 = samples[p50] / 1e6;
+  return summary;
+}
+
+/*
+ * Refreshes the cpu utilization of the monitor since the last call, and its
+ * resident set size. Always reads the real /proc, whatever the proc root.
+ */
+void Instrumentation::UpdateSelf() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    double cpu_time = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                      usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    auto now = std::chrono::steady_clock::now();
+    if (self_time_ != std::chrono::steady_clock::time_point()) {
+      std::chrono::duration<double> elapsed = now - self_time_;
+      if (elapsed.count() > 0.0) {
+        self_cpu_ = (cpu_time - self_cpu_time_) / elapsed.count();
+      }
+    }
+    self_time_ = now;
+    self_cpu_time_ = cpu_time;
+  }
+  // /proc/self/statm holds the size and the resident set size, in pages
+  std::string_view statm = LinuxParser::ReadFile(
+      (LinuxParser::kProcRoot + "/self/statm").c_str());
+  unsigned long pages = 0;
+  if (LinuxParser::ParseNumber(LinuxParser::GetValueFromLine(statm, 1),
+                               pages)) {
+    self_ram_ = pages * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+}
+
+// a fraction of one cpu
+float Instrumentation::SelfCpu() const { return self_cpu_; }
+
+// kB
+unsigned long Instrumentation::SelfRam() const { return self_ram_; }
+
+ScopedTimer::ScopedTimer(Instrumentation& instrumentation,
+                         Instrumentation::Phase_t phase)
+    : instrumentation_(instrumentation),
+      phase_(phase),
+      start_(std::chrono::steady_clock::now()) {}
+
+ScopedTimer::~ScopedTimer() {
+  instrumentation_.Add(phase_, std::chrono::steady_clock::now() - start_);
+}
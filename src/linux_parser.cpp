@@ -1,100 +1,259 @@
 #include "linux_parser.h"
 
+#include <fcntl.h>
 #include <unistd.h>
 
-#include <experimental/filesystem>
+#include <algorithm>
+#include <cerrno>
 #include <fstream>
 #include <regex>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using std::string;
-using std::to_string;
+using std::string_view;
 using std::vector;
 
-namespace fs = std::experimental::filesystem;
+namespace {
+// Reused by every read on a thread, so steady-state parsing never allocates.
+// The buffer only grows when a file larger than any seen before is read.
+thread_local vector<char> file_buffer(4096);
+thread_local char path_buffer[4096];
 
+// both are only written by SetRoots(), before any thread reads them
+std::string proc_directory{LinuxParser::kProcRoot + "/"};
+std::string etc_root{LinuxParser::kEtcRoot};
+}  // namespace
+
+// parsing shared by the process and thread readers below
+namespace LinuxParser {
+namespace {
 /*
- * Returns a line from a file at given path whose first token matches key.
- * If key is not supplied, the first line of the file is returned.
- * An empty string is returned if key is supplied but not found, or if
- * the file was not opened.
+ * Fills stat from a line of /proc/[pid]/stat or /proc/[pid]/task/[tid]/stat,
+ * which share a format. The comm field may itself contain spaces and
+ * parentheses, so tokenizing resumes after the last closing parenthesis in the
+ * line.
  */
-string LinuxParser::GetLineFromFile(const string& path,
-                                    const string& key = "") {
-  std::ifstream filestream(path);
-  if (filestream.is_open()) {
-    string line;
-    if (key.empty()) {
-      std::getline(filestream, line);
-      return line;
+bool ParsePidStat(string_view line, ::PidStat& stat) {
+  size_t r_paren = line.rfind(')');
+  if (r_paren == string_view::npos ||
+      !ParseNumber(GetValueFromLine(line, PidStat::kPid_), stat.pid)) {
+    return false;
+  }
+  line.remove_prefix(r_paren + 1);
+  for (int index = PidStat::kState_; index <= PidStat::kStartTime_; index++) {
+    string_view token = NextToken(line);
+    if (token.empty()) {
+      return false;
     }
-    while (std::getline(filestream, line)) {
-      if (line.compare(0, key.length(), key) == 0) {
-        return line;
-      }
+    switch (index) {
+      case PidStat::kState_:
+        stat.state = token.front();
+        break;
+      case PidStat::kPPid_:
+        ParseNumber(token, stat.ppid);
+        break;
+      case PidStat::kMinFlt_:
+        ParseNumber(token, stat.minflt);
+        break;
+      case PidStat::kMajFlt_:
+        ParseNumber(token, stat.majflt);
+        break;
+      case PidStat::kUtime_:
+        ParseNumber(token, stat.utime);
+        break;
+      case PidStat::kStime_:
+        ParseNumber(token, stat.stime);
+        break;
+      case PidStat::kThreads_:
+        ParseNumber(token, stat.threads);
+        break;
+      case PidStat::kStartTime_:
+        ParseNumber(token, stat.starttime);
+        break;
+      default:;
     }
   }
-  return string();
+  return true;
+}
+
+// the comm field of a stat line, in its parentheses
+string_view CommFromStat(string_view line) {
+  size_t l_paren = line.find('(');
+  size_t r_paren = line.rfind(')');
+  if (l_paren != string_view::npos && r_paren != string_view::npos &&
+      r_paren > l_paren) {
+    return line.substr(l_paren, r_paren - l_paren + 1);
+  }
+  return string_view();
 }
+}  // namespace
+}  // namespace LinuxParser
 
 /*
- * Tokenizes the input string and returns of vector of strings containing the
- * tokens.
+ * Reads proc and etc files from the given directories instead of /proc and
+ * /etc. A trailing slash is optional. Must be called before any file is read.
  */
-vector<string> LinuxParser::GetValuesFromLine(const string& line) {
-  string value;
-  vector<string> values;
-  std::istringstream linestream(line);
-  while (linestream >> value) {
-    values.emplace_back(value);
+void LinuxParser::SetRoots(string proc, string etc) {
+  while (proc.size() > 1 && proc.back() == '/') {
+    proc.pop_back();
   }
-  return values;
+  while (etc.size() > 1 && etc.back() == '/') {
+    etc.pop_back();
+  }
+  proc_directory = proc + "/";
+  etc_root = etc;
+}
+
+// false once SetRoots() has moved the proc root away from the real one
+bool LinuxParser::DefaultProcRoot() { return proc_directory == kProcRoot + "/"; }
+
+// the proc root, with a trailing slash
+const string& LinuxParser::ProcDirectory() { return proc_directory; }
+
+// filename starts with a slash, as the k*Filename constants do
+string LinuxParser::ProcPath(const string& filename) {
+  return proc_directory + (filename.empty() ? filename : filename.substr(1));
+}
+
+string LinuxParser::EtcPath(const string& filename) {
+  return etc_root + filename;
 }
 
 /*
- * Returns the token at given index from an white space deliminated input
- * string. Will return the first token if no index is supplied. If the input
- * line is empty, or an out of range index was supplied, then will return an
- * empty string.
+ * Builds the path ProcDirectory() + pid + filename in a per-thread buffer and
+ * returns it. The result is overwritten by the next call on the same thread.
+ */
+const char* LinuxParser::PidPath(unsigned int pid, const string& filename) {
+  char* end = path_buffer + sizeof(path_buffer) - 1;
+  char* p =
+      std::copy(proc_directory.begin(), proc_directory.end(), path_buffer);
+  p = std::to_chars(p, end, pid).ptr;
+  size_t len = std::min(filename.size(), (size_t)(end - p));
+  p = std::copy_n(filename.begin(), len, p);
+  *p = '\0';
+  return path_buffer;
+}
+
+/*
+ * Builds the path of filename for thread tid of process pid, in the same
+ * buffer as PidPath().
+ */
+const char* LinuxParser::TaskPath(unsigned int pid, unsigned int tid,
+                                  const string& filename) {
+  char* end = path_buffer + sizeof(path_buffer) - 1;
+  char* p =
+      std::copy(proc_directory.begin(), proc_directory.end(), path_buffer);
+  p = std::to_chars(p, end, pid).ptr;
+  size_t len = std::min(kTaskDirectory.size(), (size_t)(end - p));
+  p = std::copy_n(kTaskDirectory.begin(), len, p);
+  p = std::to_chars(p, end, tid).ptr;
+  len = std::min(filename.size(), (size_t)(end - p));
+  p = std::copy_n(filename.begin(), len, p);
+  *p = '\0';
+  return path_buffer;
+}
+
+/*
+ * Reads the whole file at path into the per-thread buffer and returns a view
+ * of its contents. An empty view is returned if the file could not be opened.
  */
-string LinuxParser::GetValueFromLine(const string& line, const int index) {
-  string value;
-  std::istringstream linestream(line);
-  int count = 0;
-  while (linestream >> value) {
-    if (index == count) {
-      return value;
+string_view LinuxParser::ReadFile(const char* path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return string_view();
+  }
+  size_t size = 0;
+  while (true) {
+    if (size == file_buffer.size()) {
+      file_buffer.resize(file_buffer.size() * 2);
+    }
+    ssize_t n = read(fd, file_buffer.data() + size, file_buffer.size() - size);
+    if (n < 0 && errno == EINTR) {
+      continue;
     }
-    count++;
+    if (n <= 0) {
+      break;
+    }
+    size += n;
   }
+  close(fd);
+  return string_view(file_buffer.data(), size);
+}
 
-  return string();
+/*
+ * Returns a line from a file at given path whose first token matches key.
+ * If key is not supplied, the first line of the file is returned.
+ * An empty view is returned if key is supplied but not found, or if
+ * the file was not opened.
+ */
+string_view LinuxParser::GetLineFromFile(const char* path, string_view key) {
+  string_view contents = ReadFile(path);
+  while (!contents.empty()) {
+    string_view line = NextLine(contents);
+    if (key.empty() || line.compare(0, key.length(), key) == 0) {
+      return line;
+    }
+  }
+  return string_view();
 }
 
 /*
- * Sometimes the filename aka "comm" field in /proc/pid/stat contains spaces
- * within the parenthesis. This will replace those spaces with an underscore to
- * allow for correct tokenization of the line
+ * Removes the first line from contents and returns it without the trailing
+ * newline.
  */
-void LinuxParser::FixTokenInParens(string& line) {
-  size_t l_paren = line.find('(');
-  if (l_paren == string::npos) {
-    return;
+string_view LinuxParser::NextLine(string_view& contents) {
+  size_t newline = contents.find('\n');
+  string_view line = contents.substr(0, newline);
+  contents.remove_prefix(newline == string_view::npos ? contents.size()
+                                                      : newline + 1);
+  return line;
+}
+
+/*
+ * Removes the first white space delimited token from line and returns it. An
+ * empty view is returned once line has no tokens left.
+ */
+string_view LinuxParser::NextToken(string_view& line) {
+  size_t start = line.find_first_not_of(" \t\n");
+  if (start == string_view::npos) {
+    line = string_view();
+    return string_view();
+  }
+  size_t end = line.find_first_of(" \t\n", start);
+  string_view token = line.substr(start, end - start);
+  line.remove_prefix(end == string_view::npos ? line.size() : end);
+  return token;
+}
+
+/*
+ * Returns the token at given index from an white space deliminated input
+ * string. Will return the first token if no index is supplied. If the input
+ * line is empty, or an out of range index was supplied, then will return an
+ * empty view.
+ */
+string_view LinuxParser::GetValueFromLine(string_view line, const int index) {
+  string_view value;
+  for (int count = 0; count <= index; count++) {
+    value = NextToken(line);
+    if (value.empty()) {
+      break;
+    }
   }
-  size_t r_paren = line.find(')', l_paren + 1);
-  std::replace(line.begin() + l_paren, line.begin() + r_paren, ' ', '_');
+  return value;
 }
 
 string LinuxParser::Kernel() {
-  string line = GetLineFromFile(kProcDirectory + kVersionFilename);
-  return GetValueFromLine(line, Version::kKernel_);
+  string_view line =
+      GetLineFromFile(ProcPath(kVersionFilename).c_str());
+  return string(GetValueFromLine(line, Version::kKernel_));
 }
 
 string LinuxParser::OperatingSystem() {
   string key, value, line;
-  std::ifstream filestream(kOSPath);
+  std::ifstream filestream(EtcPath(kOSFilename));
   if (filestream.is_open()) {
     while (std::getline(filestream, line)) {
       std::replace(line.begin(), line.end(), ' ', '_');
@@ -112,221 +271,100 @@ string LinuxParser::OperatingSystem() {
   return string();
 }
 
-vector<unsigned int> LinuxParser::Pids() {
-  vector<unsigned int> pids;
-  const fs::path directory{kProcDirectory};
-  for (auto& file : fs::directory_iterator(directory)) {
-    // Is this a directory?
-    if (fs::is_directory(file.status())) {
-      // Is every character of the name a digit?
-      string filename(file.path().filename());
-      if (std::all_of(filename.begin(), filename.end(), isdigit)) {
-        unsigned int pid = stoi(filename);
-        pids.push_back(pid);
-      }
+/*
+ * Parses the contents of /proc/meminfo, which the caller keeps open as a
+ * ProcFile.
+ */
+float LinuxParser::MemoryUtilization(string_view contents) {
+  long total = 0, available = 0;
+  for (int i = 0; i < 3 && !contents.empty(); i++) {
+    string_view line = NextLine(contents);
+    if (i == 0) {
+      ParseNumber(GetValueFromLine(line, 1), total);
+    } else if (i == 2) {
+      ParseNumber(GetValueFromLine(line, 1), available);
     }
   }
-  return pids;
-}
-
-float LinuxParser::MemoryUtilization() {
-  string key, value, line;
-  long total, available;
-  std::ifstream filestream(kProcDirectory + kMeminfoFilename);
-  if (filestream.is_open()) {
-    for (int i = 0; i < 3; i++) {
-      std::getline(filestream, line);
-      std::istringstream linestream(line);
-      linestream >> key >> value;
-      if (i == 0) {
-        total = stol(value);
-      } else if (i == 2) {
-        available = stol(value);
-      }
-    }
-    if (total > 0) {
-      return (float)(total - available) / (float)total;
-    }
+  if (total > 0) {
+    return (float)(total - available) / (float)total;
   }
   return 0.0;
 }
 
-unsigned long LinuxParser::UpTime() {
-  string uptime;
-  string line = GetLineFromFile(kProcDirectory + kUptimeFilename);
-  std::istringstream linestream(line);
-  linestream >> uptime;
-  if (uptime.empty()) {
-    return 0;
-  }
-  return stoul(uptime);
-}
-
-unsigned long LinuxParser::Jiffies(int index) {
-  unsigned long total = 0;
-  vector<string> values = CpuUtilization(index);
-  if (values.size() > CPUStates::kSteal_) {
-    for (int i = CPUStates::kUser_; i <= CPUStates::kSteal_; i++) {
-      total += stoul(values.at(i));
-    }
-  }
-  return total;
-}
-
-unsigned long LinuxParser::ActiveJiffies(int index) {
-  unsigned long active = 0;
-  vector<string> values = CpuUtilization(index);
-  if (values.size() > CPUStates::kSteal_) {
-    active = stoul(values.at(CPUStates::kUser_));
-    active += stoul(values.at(CPUStates::kNice_));
-    active += stoul(values.at(CPUStates::kSystem_));
-    active += stoul(values.at(CPUStates::kIRQ_));
-    active += stoul(values.at(CPUStates::kSoftIRQ_));
-    active += stoul(values.at(CPUStates::kSteal_));
-  }
-  return active;
-}
-
-unsigned long LinuxParser::IdleJiffies(int index) {
-  unsigned long idle = 0;
-  vector<string> values = CpuUtilization(index);
-  if (values.size() > CPUStates::kIOwait_) {
-    idle = stoul(values.at(CPUStates::kIdle_));
-    idle += stoul(values.at(CPUStates::kIOwait_));
-  }
-  return idle;
-}
-
-unsigned long LinuxParser::TotalProcesses() {
-  string line = GetLineFromFile(kProcDirectory + kStatFilename, kProcesses);
-  string value = GetValueFromLine(line, 1);
-  if (value.empty()) {
-    return 0;
-  }
-  return stoul(value);
-}
-
-unsigned long LinuxParser::RunningProcesses() {
-  string line = GetLineFromFile(kProcDirectory + kStatFilename, kProcsRunning);
-  string value = GetValueFromLine(line, 1);
-  if (value.empty()) {
-    return 0;
-  }
-  return stoul(value);
-}
-
-vector<string> LinuxParser::CpuUtilization(int index) {
-  string cpu_key{kCpu};
-  if (index > -1) {
-    cpu_key += to_string(index);
-  }
-  string line = GetLineFromFile(kProcDirectory + kStatFilename, cpu_key);
-  return GetValuesFromLine(line);
+/*
+ * Parses the contents of /proc/uptime, which the caller keeps open as a
+ * ProcFile.
+ */
+double LinuxParser::UpTime(string_view contents) {
+  double uptime = 0.0;
+  ParseNumber(GetValueFromLine(contents), uptime);
+  return uptime;
 }
 
+/*
+ * The arguments in /proc/[pid]/cmdline are separated by NUL characters, which
+ * are replaced by spaces, as ps and top show them.
+ */
 string LinuxParser::Command(unsigned int pid) {
-  return GetLineFromFile(kProcDirectory + to_string(pid) + kCmdlineFilename);
-}
-
-string LinuxParser::Filename(unsigned int pid) {
-  string line =
-      GetLineFromFile(kProcDirectory + to_string(pid) + kStatFilename);
-  size_t l_paren = line.find('(');
-  size_t r_paren = line.find(')', l_paren + 1);
-  if (l_paren > 0 && r_paren > l_paren) {
-    return line.substr(l_paren, r_paren - l_paren + 1);
+  string command(GetLineFromFile(PidPath(pid, kCmdlineFilename)));
+  while (!command.empty() && command.back() == '\0') {
+    command.pop_back();
   }
-  return string();
+  std::replace(command.begin(), command.end(), '\0', ' ');
+  return command;
 }
 
-int LinuxParser::GetTotalCpus() {
-  int total{-1};
-  std::ifstream filestream(kProcDirectory + kStatFilename);
-  if (filestream.is_open()) {
-    string line;
-    while (std::getline(filestream, line)) {
-      if (GetValueFromLine(line).substr(0, 3).compare(kCpu) == 0) {
-        total++;
-      }
-    }
-  }
-  return total;
+string LinuxParser::Filename(unsigned int pid) {
+  return string(CommFromStat(GetLineFromFile(PidPath(pid, kStatFilename))));
 }
 
-string LinuxParser::Ram(unsigned int pid) {
+/*
+ * Returns the resident set size of the process in kB.
+ */
+unsigned long LinuxParser::Ram(unsigned int pid) {
   // Using VmRSS here instead of VmSize because VmSize includes virtual memory
   // used by the process, and VmRSS gives exact physical memory being used.
   //
   // see https://man7.org/linux/man-pages/man5/proc.5.html for more info.
-  string line = GetLineFromFile(
-      kProcDirectory + to_string(pid) + kStatusFilename, kVmRSS);
-  if (line.empty()) {
-    return "0.00000";
-  }
-  return to_string(std::stof(GetValueFromLine(line, 1)) / 1000.0);
+  string_view line = GetLineFromFile(PidPath(pid, kStatusFilename), kVmRSS);
+  unsigned long ram = 0;
+  ParseNumber(GetValueFromLine(line, 1), ram);
+  return ram;
 }
 
 string LinuxParser::Uid(unsigned int pid) {
-  string line =
-      GetLineFromFile(kProcDirectory + to_string(pid) + kStatusFilename, kUid);
-  return GetValueFromLine(line, 1);
-}
-
-string LinuxParser::User(unsigned int pid) {
-  string line;
-  string uid = Uid(pid);
-  if (uid.empty()) {
-    return string();
-  }
-  std::ifstream filestream(kPasswordPath);
-  if (filestream.is_open()) {
-    while (std::getline(filestream, line)) {
-      std::istringstream linestream(line);
-      string value;
-      vector<string> values;
-      while (values.size() < User::kUid_ + 1 &&
-             std::getline(linestream, value, ':')) {
-        values.emplace_back(value);
-      }
-      if (values.size() > User::kUid_ &&
-          values.at(User::kUid_).compare(uid) == 0) {
-        return values.at(User::kUserName_);
-      }
-    }
-  }
-  return string();
+  string_view line = GetLineFromFile(PidPath(pid, kStatusFilename), kUid);
+  return string(GetValueFromLine(line, 1));
 }
 
-unsigned long LinuxParser::UpTime(unsigned int pid) {
-  string line =
-      GetLineFromFile(kProcDirectory + to_string(pid) + kStatFilename);
-  FixTokenInParens(line);
-  string start_time_str = GetValueFromLine(line, PidStat::kStartTime_);
-  if (start_time_str.empty()) {
-    return 0;
-  }
-  unsigned long start_time = stoul(start_time_str);
-  return UpTime() - (start_time / sysconf(_SC_CLK_TCK));
+/*
+ * Reads and tokenizes /proc/[pid]/stat once, filling stat with the fields used
+ * by Process. Returns false if the file could not be read, which is a good
+ * indication the process has been killed.
+ */
+bool LinuxParser::ReadPidStat(unsigned int pid, ::PidStat& stat) {
+  return ParsePidStat(GetLineFromFile(PidPath(pid, kStatFilename)), stat);
 }
 
-unsigned long LinuxParser::ActiveJiffies(unsigned int pid) {
-  unsigned long active = 0;
-  string line =
-      GetLineFromFile(kProcDirectory + to_string(pid) + kStatFilename);
-  FixTokenInParens(line);
-  vector<string> values = GetValuesFromLine(line);
-
-  if (values.size() > PidStat::kStime_) {
-    for (int i = PidStat::kUtime_; i <= PidStat::kStime_; i++) {
-      active += stoul(values.at(i));
-    }
+/*
+ * The name of thread tid of process pid, without the parentheses Filename()
+ * keeps around the name of a process.
+ */
+string LinuxParser::ThreadName(unsigned int pid, unsigned int tid) {
+  string_view comm =
+      CommFromStat(GetLineFromFile(TaskPath(pid, tid, kStatFilename)));
+  if (comm.size() >= 2) {
+    comm = comm.substr(1, comm.size() - 2);
   }
-  return active;
+  return string(comm);
 }
 
-string LinuxParser::State(unsigned int pid) {
-  string line =
-      GetLineFromFile(kProcDirectory + to_string(pid) + kStatFilename);
-  FixTokenInParens(line);
-  return GetValueFromLine(line, PidStat::kState_);
+/*
+ * Reads /proc/[pid]/task/[tid]/stat as ReadPidStat() reads the stat of a
+ * process. The times and state are those of the single thread.
+ */
+bool LinuxParser::ReadTaskStat(unsigned int pid, unsigned int tid,
+                               ::PidStat& stat) {
+  return ParsePidStat(GetLineFromFile(TaskPath(pid, tid, kStatFilename)),
+                      stat);
 }
@@ -1,7 +1,213 @@
+#include <getopt.h>
+
+#include <chrono>
+#include <climits>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "batch_display.h"
+#include "linux_parser.h"
 #include "ncurses_display.h"
+#include "recorder.h"
+#include "replayer.h"
+#include "sampler.h"
 #include "system.h"
+#include "worker_pool.h"
+
+// options without a short form
+#define TOP_OPTION 256
+#define SPEED_OPTION 257
+#define SEEK_OPTION 258
+#define PROC_OPTION 259
+#define ETC_OPTION 260
+
+void Usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -d, --delay SECS     seconds between samples, fractions allowed "
+          "(default: 1)\n"
+          "  -s, --scan           scan /proc for new processes instead of "
+          "using the\n"
+          "                       kernel proc connector\n"
+          "  -t, --threads N      worker threads sampling processes "
+          "(default: online cpus / 4)\n"
+          "  -b, --batch          write records to stdout instead of "
+          "running the display\n"
+          "  -n, --iterations N   stop after N records in batch mode "
+          "(default: 0, no limit)\n"
+          "  -f, --format FORMAT  jsonl or csv in batch mode "
+          "(default: jsonl)\n"
+          "      --top N          processes per record in batch mode, "
+          "0 for all (default: 20)\n"
+          "  -r, --record FILE    record every sample to FILE\n"
+          "  -R, --replay FILE    show a recording instead of this system\n"
+          "      --speed X        replay X times faster than recorded "
+          "(default: 1)\n"
+          "      --seek SECS      start the replay SECS into the recording\n"
+          "      --proc DIR       read DIR instead of /proc, implies --scan\n"
+          "      --etc DIR        read DIR instead of /etc\n",
+          name);
+}
+
+/*
+ * Parses text as a decimal count of at most max. Signs, white space and
+ * trailing characters are rejected, which strtoul() alone would accept.
+ */
+bool ParseCount(const char* text, unsigned long max, unsigned long& count) {
+  if (*text < '0' || *text > '9') {
+    return false;
+  }
+  char* end;
+  errno = 0;
+  count = strtoul(text, &end, 10);
+  return *end == '\0' && errno == 0 && count <= max;
+}
+
+int main(int argc, char* argv[]) {
+  unsigned long threads = 0;
+  double delay = 1.0;
+  bool events = true;
+  bool batch = false;
+  unsigned long iterations = 0;
+  BatchDisplay::Format_t format = BatchDisplay::kJsonl_;
+  unsigned long top = 20;
+  std::string record;
+  std::string replay;
+  double speed = 1.0;
+  double seek = 0.0;
+  std::string proc = LinuxParser::kProcRoot;
+  std::string etc = LinuxParser::kEtcRoot;
+  const struct option options[] = {
+      {"delay", required_argument, nullptr, 'd'},
+      {"scan", no_argument, nullptr, 's'},
+      {"threads", required_argument, nullptr, 't'},
+      {"batch", no_argument, nullptr, 'b'},
+      {"iterations", required_argument, nullptr, 'n'},
+      {"format", required_argument, nullptr, 'f'},
+      {"top", required_argument, nullptr, TOP_OPTION},
+      {"record", required_argument, nullptr, 'r'},
+      {"replay", required_argument, nullptr, 'R'},
+      {"speed", required_argument, nullptr, SPEED_OPTION},
+      {"seek", required_argument, nullptr, SEEK_OPTION},
+      {"proc", required_argument, nullptr, PROC_OPTION},
+      {"etc", required_argument, nullptr, ETC_OPTION},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "d:st:bn:f:r:R:h", options, nullptr)) !=
+         -1) {
+    switch (opt) {
+      case 'd':
+        delay = strtod(optarg, nullptr);
+        if (!(delay >= 0.01)) {
+          fprintf(stderr, "%s: delay must be at least 0.01 seconds\n",
+                  argv[0]);
+          return 1;
+        }
+        break;
+      case 's':
+        events = false;
+        break;
+      case 't':
+        if (!ParseCount(optarg, WorkerPool::MaxSize(), threads)) {
+          fprintf(stderr, "%s: threads must be a number from 0 to %zu\n",
+                  argv[0], WorkerPool::MaxSize());
+          return 1;
+        }
+        break;
+      case 'b':
+        batch = true;
+        break;
+      case 'n':
+        if (!ParseCount(optarg, ULONG_MAX, iterations)) {
+          fprintf(stderr, "%s: iterations must be a number\n", argv[0]);
+          return 1;
+        }
+        break;
+      case 'f':
+        if (strcmp(optarg, "jsonl") == 0) {
+          format = BatchDisplay::kJsonl_;
+        } else if (strcmp(optarg, "csv") == 0) {
+          format = BatchDisplay::kCsv_;
+        } else {
+          fprintf(stderr, "%s: unknown format %s\n", argv[0], optarg);
+          return 1;
+        }
+        break;
+      case TOP_OPTION:
+        if (!ParseCount(optarg, ULONG_MAX, top)) {
+          fprintf(stderr, "%s: top must be a number\n", argv[0]);
+          return 1;
+        }
+        break;
+      case 'r':
+        record = optarg;
+        break;
+      case 'R':
+        replay = optarg;
+        break;
+      case SPEED_OPTION:
+        speed = strtod(optarg, nullptr);
+        if (!(speed > 0.0)) {
+          fprintf(stderr, "%s: speed must be positive\n", argv[0]);
+          return 1;
+        }
+        break;
+      case SEEK_OPTION:
+        seek = strtod(optarg, nullptr);
+        break;
+      case PROC_OPTION:
+        proc = optarg;
+        break;
+      case ETC_OPTION:
+        etc = optarg;
+        break;
+      case 'h':
+        Usage(argv[0]);
+        return 0;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (!replay.empty() && batch) {
+    fprintf(stderr, "%s: --replay drives the display, not --batch\n", argv[0]);
+    return 1;
+  }
+  if (!replay.empty()) {
+    Replayer replayer(replay, speed);
+    if (!replayer.IsOpen()) {
+      fprintf(stderr, "%s: %s is not a readable recording\n", argv[0],
+              replay.c_str());
+      return 1;
+    }
+    System system(replayer.Kernel(), replayer.OperatingSystem(),
+                  replayer.TotalCpus());
+    replayer.Seek(seek);
+    NCursesDisplay::Display(system, replayer);
+    return 0;
+  }
 
-int main() {
-  System system;
-  NCursesDisplay::Display(system);
-}
\ No newline at end of file
+  LinuxParser::SetRoots(proc, etc);
+  System system(threads, events);
+  // declared before the sampler, so it outlives the sampling thread
+  std::unique_ptr<Recorder> recorder;
+  if (!record.empty()) {
+    recorder = std::make_unique<Recorder>(record, system);
+    if (!recorder->IsOpen()) {
+      fprintf(stderr, "%s: cannot write %s\n", argv[0], record.c_str());
+      return 1;
+    }
+  }
+  Sampler sampler(system, std::chrono::milliseconds((long long)(delay * 1000)));
+  sampler.SetRecorder(recorder.get());
+  if (batch) {
+    return BatchDisplay::Display(system, sampler, iterations, format, top);
+  }
+  NCursesDisplay::Display(system, sampler);
+}
@@ -1,50 +1,159 @@
 #include "ncurses_display.h"
 
 #include <curses.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
 #include <string>
-#include <thread>
+#include <string_view>
 #include <vector>
 
 #include "format.h"
+#include "history.h"
+#include "instrumentation.h"
+#include "process_sorter.h"
+#include "row_cache.h"
+#include "snapshot_source.h"
+#include "snapshot.h"
 #include "system.h"
 
 using std::string;
+using std::string_view;
 using std::to_string;
 
+namespace {
+// rows written through a cache, which Resize() invalidates along with the
+// windows it erases
+RowCache system_rows;
+RowCache process_rows_drawn;
+// threads of the process being drawn, in the order they are shown
+std::vector<const Process*> thread_rows;
+// samples of the series being drawn as a sparkline
+std::vector<float> graph_samples;
+
 /*
- * taken from:
- * https://stackoverflow.com/questions/4025891/create-a-function-to-check-for-key-press-in-unix-using-ncurses
+ * The first of the threads of process pid in snapshot.threads, which is sorted
+ * by process. The threads of pid follow it.
  */
-int NCursesDisplay::Keypress(void) {
-  int ch = getch();
+std::vector<Process>::const_iterator FirstThread(const Snapshot& snapshot,
+                                                 unsigned int pid) {
+  return std::lower_bound(
+      snapshot.threads.begin(), snapshot.threads.end(), pid,
+      [](const Process& thread, unsigned int pid) {
+        return thread.Tgid() < pid;
+      });
+}
 
-  if (ch != ERR) {
-    ungetch(ch);
-    return 1;
-  } else {
-    return 0;
+// the number of rows process pid takes, with its threads
+size_t ProcessRows(const Snapshot& snapshot, unsigned int pid) {
+  size_t rows = 1;
+  for (auto thread = FirstThread(snapshot, pid);
+       thread != snapshot.threads.end() && thread->Tgid() == pid; thread++) {
+    rows++;
   }
+  return rows;
 }
 
-void NCursesDisplay::CheckEvents(System& system, WINDOW* system_w,
-                                 WINDOW* process_w, int& process_rows) {
-  if (Keypress()) {
-    switch (getch()) {
+/*
+ * Copies text into line at col, cut off at the end of line, as mvwprintw()
+ * would have cut it off at the edge of the window.
+ */
+void Place(string& line, size_t col, string_view text) {
+  if (col < line.size()) {
+    line.replace(col, std::min(text.size(), line.size() - col),
+                 text.substr(0, line.size() - col));
+  }
+}
+}  // namespace
+
+/*
+ * Handles the next pending keypress without waiting. Returns the key, or ERR
+ * if none was pending. Quitting is left to the caller.
+ */
+int NCursesDisplay::CheckEvents(System& system, WINDOW* system_w,
+                                WINDOW* process_w, int& process_rows,
+                                Viewport& viewport) {
+  int ch = getch();
+  if (ch != ERR) {
+    switch (ch) {
+      case KEY_UP:
+        MoveSelection(viewport, -1, false);
+        break;
+      case KEY_DOWN:
+        MoveSelection(viewport, 1, false);
+        break;
+      case KEY_PPAGE:
+        MoveSelection(viewport, -process_rows, true);
+        break;
+      case KEY_NPAGE:
+        MoveSelection(viewport, process_rows, true);
+        break;
+      case KEY_HOME:
+        viewport.top = 0;
+        viewport.selected = 0;
+        viewport.moved = true;
+        break;
+      case KEY_END:
+        // clamped to the last process by PlaceViewport()
+        viewport.top = SIZE_MAX;
+        viewport.selected = SIZE_MAX;
+        viewport.moved = true;
+        break;
       case KEY_RESIZE:
         Resize(system, system_w, process_w, process_rows);
         break;
-      case 'h':
+      case 'v':
+      case 'V':
+        // processes under their parents
+        system.ToggleTree();
+        break;
+      case '\n':
+      case KEY_ENTER:
+        // hide or show the descendants of the selection in the tree
+        if (system.ShowTree()) {
+          Collapse(viewport, -1);
+        }
+        break;
+      case KEY_LEFT:
+        if (system.ShowTree()) {
+          Collapse(viewport, 1);
+        }
+        break;
+      case KEY_RIGHT:
+        if (system.ShowTree()) {
+          Collapse(viewport, 0);
+        }
+        break;
       case 'H':
+        // threads of the processes on screen
+        system.ToggleThreads();
+        break;
+      case 'h':
         system.ToggleCores();
         Resize(system, system_w, process_w, process_rows);
         break;
+      case 'g':
+      case 'G':
+        // recent CPU% or RAM of each process
+        system.ToggleHistory();
+        Resize(system, system_w, process_w, process_rows);
+        break;
+      case 'i':
+      case 'I':
+        // timings of the monitor itself
+        system.ToggleTimings();
+        break;
       case 'q':
       case 'Q':
-        // Quit program
-        endwin();
-        exit(0);
+        // Quit program, handled by Display()
         break;
       case 'c':
       case 'C':
@@ -95,15 +204,8 @@ void NCursesDisplay::CheckEvents(System& system, WINDOW* system_w,
       }
       default:;
     }
-    // because our main loop sleeps 1 sec every iteration, clearing the
-    // input buffer after receiving 1 char seems like a good idea to stop input
-    // chars from piling up.
-    flushinp();
   }
-}
-
-void NCursesDisplay::ClearLine(WINDOW* window, int row) {
-  mvwprintw(window, row, 1, (string(window->_maxx - 1, ' ').c_str()));
+  return ch;
 }
 
 /*
@@ -139,6 +241,130 @@ void NCursesDisplay::AddColorChar(WINDOW* window, int color, chtype c) {
   wattroff(window, COLOR_PAIR(color));
 }
 
+/*
+ * Moves the selection by rows, and with page the rows shown along with it, so
+ * the selection stays on the same line of the screen.
+ */
+void NCursesDisplay::MoveSelection(Viewport& viewport, long rows, bool page) {
+  // End stores SIZE_MAX until PlaceViewport() clamps it, and a key handled
+  // before that must not wrap it around to the first row
+  auto move = [rows](size_t index) {
+    if (rows < 0) {
+      return index - std::min(index, (size_t)-rows);
+    }
+    return index > SIZE_MAX - rows ? SIZE_MAX : index + rows;
+  };
+  viewport.selected = move(viewport.selected);
+  if (page) {
+    viewport.top = move(viewport.top);
+  }
+  viewport.moved = true;
+}
+
+/*
+ * Hides the descendants of the selected process in the tree if collapse is 1,
+ * shows them if it is 0, and toggles between the two if it is -1. The tree
+ * is laid out again for the next frame from the latest snapshot.
+ */
+void NCursesDisplay::Collapse(Viewport& viewport, int collapse) {
+  std::vector<unsigned int>& collapsed = viewport.collapsed;
+  unsigned int pid = viewport.selected_pid;
+  auto found = std::lower_bound(collapsed.begin(), collapsed.end(), pid);
+  bool hidden = found != collapsed.end() && *found == pid;
+  bool hide = collapse < 0 ? !hidden : collapse == 1;
+  if (pid == 0 || hide == hidden) {
+    return;
+  }
+  if (hide) {
+    collapsed.insert(found, pid);
+  } else {
+    collapsed.erase(found);
+  }
+}
+
+/*
+ * Sorts the processes at least as far as n rows past the ones shown, finds
+ * the selected pid in the new order, and scrolls so that it stays on screen.
+ * Past the first rows, the index is only partially sorted, so if the selected
+ * process has dropped out of the sorted part, everything is sorted once to
+ * find it. The tree is laid out in full, without the collapsed subtrees, so
+ * its rows are fewer than the processes.
+ */
+void NCursesDisplay::PlaceViewport(System& system, const Snapshot& snapshot,
+                                   ProcessSorter& sorter, Viewport& viewport,
+                                   int n) {
+  const std::vector<Process>& processes = snapshot.processes;
+  bool tree = system.ShowTree() && !snapshot.tree_order.empty();
+  if (tree) {
+    sorter.Tree(processes, snapshot.tree_order, snapshot.tree,
+                viewport.collapsed);
+  }
+  size_t count = tree ? sorter.Order().size() : processes.size();
+  size_t rows = std::max(n, 1);
+  auto sort = [&](size_t sorted) {
+    if (!tree) {
+      sorter.Sort(processes, system.Sort(), system.Descending(), sorted);
+    }
+    return tree ? count : std::min(sorted, count);
+  };
+  size_t sorted =
+      sort(std::max(std::min(viewport.top, count), std::min(viewport.selected,
+                                                            count)) +
+           2 * rows);
+  if (count == 0) {
+    viewport.top = 0;
+    viewport.selected = 0;
+    viewport.selected_pid = 0;
+    viewport.moved = false;
+    return;
+  }
+  if (!viewport.moved && viewport.selected_pid != 0) {
+    const std::vector<unsigned int>& order = sorter.Order();
+    auto find = [&](size_t end) {
+      for (size_t i = 0; i < end; i++) {
+        if (processes[order[i]].Pid() == viewport.selected_pid) {
+          return i;
+        }
+      }
+      return count;
+    };
+    size_t rank = find(sorted);
+    if (rank == count && sorted < count) {
+      sorted = sort(count);
+      rank = find(count);
+    }
+    // a selected process that exited leaves the selection on its row
+    if (rank < count) {
+      viewport.selected = rank;
+    }
+  }
+  viewport.moved = false;
+  viewport.selected = std::min(viewport.selected, count - 1);
+  if (viewport.selected < viewport.top) {
+    viewport.top = viewport.selected;
+  } else if (viewport.selected >= viewport.top + rows) {
+    viewport.top = viewport.selected - rows + 1;
+  }
+  viewport.top = std::min(viewport.top, count > rows ? count - rows : 0);
+  // threads shown under their process take rows of their own, so keeping the
+  // selection on screen may take scrolling further
+  if (!snapshot.threads.empty()) {
+    const std::vector<unsigned int>& order = sorter.Order();
+    size_t used = 0;
+    for (size_t i = viewport.top; i <= viewport.selected; i++) {
+      used += ProcessRows(snapshot, processes[order[i]].Pid());
+    }
+    while (used > rows && viewport.top < viewport.selected) {
+      used -= ProcessRows(snapshot, processes[order[viewport.top++]].Pid());
+    }
+  }
+  if (sorted < std::min(count, viewport.top + 2 * rows)) {
+    // the prefix sorted so far keeps its order, it is only extended
+    sorted = sort(viewport.top + 2 * rows);
+  }
+  viewport.selected_pid = processes[sorter.Order()[viewport.selected]].Pid();
+}
+
 void NCursesDisplay::Resize(System& system, WINDOW* system_w, WINDOW* process_w,
                             int& rows) {
   int new_x, new_y;
@@ -158,14 +384,46 @@ void NCursesDisplay::Resize(System& system, WINDOW* system_w, WINDOW* process_w,
     wresize(process_w, new_y - system_window_height, new_x);
   }
   rows = new_y - system_w->_maxy - 4;
-  wclear(stdscr);
-  wclear(system_w);
-  wclear(process_w);
+  // erased rather than cleared, so ncurses only repaints what differs from
+  // the screen instead of all of it
+  werase(stdscr);
+  werase(system_w);
+  werase(process_w);
+  system_rows.Invalidate();
+  process_rows_drawn.Invalidate();
   wrefresh(process_w);
   wrefresh(system_w);
   refresh();
 }
 
+/*
+ * Blocks SIGWINCH for the calling thread and returns a signalfd that becomes
+ * readable when the terminal is resized, or -1 if one could not be created.
+ * The sampling threads block every signal, so SIGWINCH always stays pending
+ * for this fd.
+ */
+int NCursesDisplay::WindowSizeSignalFd() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGWINCH);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  return signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+}
+
+/*
+ * Drains the SIGWINCH signalfd and tells ncurses about the new terminal size,
+ * which it can not notice on its own while the signal is blocked.
+ */
+void NCursesDisplay::ResizeTerminal(int signal_fd) {
+  struct signalfd_siginfo info;
+  while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+  }
+  struct winsize size;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) {
+    resizeterm(size.ws_row, size.ws_col);
+  }
+}
+
 // 50 bars uniformly displayed from 0 - 100 %
 // 2% is one bar(|)
 std::string NCursesDisplay::ProgressBar(float percent) {
@@ -183,14 +441,30 @@ std::string NCursesDisplay::ProgressBar(float percent) {
   return result + " " + display + "/100%";
 }
 
+/*
+ * Draws the last width samples, oldest first, as one character each, scaled
+ * so that high is the tallest. Fewer samples are aligned to the right.
+ */
+std::string NCursesDisplay::Sparkline(const std::vector<float>& samples,
+                                      float high, size_t width) {
+  size_t shown = std::min(samples.size(), width);
+  string result(width - shown, ' ');
+  size_t top = kSparkLevels.size() - 1;
+  for (size_t i = samples.size() - shown; i < samples.size(); i++) {
+    long level = high > 0 ? std::lround(samples[i] / high * top) : 0;
+    result += kSparkLevels[std::clamp(level, 0L, (long)top)];
+  }
+  return result;
+}
+
 void NCursesDisplay::SystemMenu(System& sys, WINDOW* win, int& row, int col) {
   mvwprintw(win, row, col, "[ ");
   col += 2;
   if (sys.ShowCores()) {
-    BoldUnderlineAndColor(win, 3, row, col, kHideCores);
+    BoldUnderlineAndColor(win, 3, row, col, kHideCores, kHideCores.find('h'));
     col += kHideCores.size();
   } else {
-    BoldUnderlineAndColor(win, 3, row, col, kShowCores, 1);
+    BoldUnderlineAndColor(win, 3, row, col, kShowCores, kShowCores.find('h'));
     col += kShowCores.size();
   }
   mvwprintw(win, row, col, " ]");
@@ -202,10 +476,11 @@ void NCursesDisplay::SystemMenu(System& sys, WINDOW* win, int& row, int col) {
   mvwprintw(win, row, col, " ]");
 }
 
-void NCursesDisplay::SystemInfo(System& sys, WINDOW* win, int& row, int col) {
+void NCursesDisplay::SystemInfo(System& sys, const Snapshot& snap, WINDOW* win,
+                                int& row, int col) {
   std::string os = kOs + sys.OperatingSystem();
   std::string kernel = kKernel + sys.Kernel();
-  std::string uptime = kUpTime + Format::ElapsedTime(sys.UpTime());
+  std::string uptime = kUpTime + Format::ElapsedTime(snap.uptime);
   if (sys.ShowCores()) {
     mvwprintw(win, row, col, os.c_str());
     mvwprintw(win, row, (win->_maxx - kernel.size()) / 2, kernel.c_str());
@@ -217,31 +492,50 @@ void NCursesDisplay::SystemInfo(System& sys, WINDOW* win, int& row, int col) {
   }
 }
 
-void NCursesDisplay::CpuBars(System& sys, WINDOW* win, int& row, int col) {
+/*
+ * Each bar is followed by the recent utilization of its cpu, as many samples
+ * as fit before the border.
+ */
+void NCursesDisplay::CpuBars(System& sys, const Snapshot& snap,
+                             const History& history, WINDOW* win, int& row,
+                             int col) {
+  auto graph = [&](int series) {
+    int start = getcurx(win) + 2;
+    int width = getmaxx(win) - 2 - start;
+    if (width <= 0) {
+      return;
+    }
+    history.Cpu(series, width, graph_samples);
+    wattron(win, COLOR_PAIR(3));
+    mvwaddstr(win, row, start, Sparkline(graph_samples, 1.0, width).c_str());
+    wattroff(win, COLOR_PAIR(3));
+  };
   mvwprintw(win, row, col, (kCpuCore + ":").c_str());
   wattron(win, COLOR_PAIR(1));
   mvwprintw(win, row, col + 8, "");
-  wprintw(win, ProgressBar(sys.Cpu().Utilization()).c_str());
+  wprintw(win, ProgressBar(snap.cpu.Utilization()).c_str());
   wattroff(win, COLOR_PAIR(1));
+  graph(0);
 
   if (sys.ShowCores()) {
-    std::vector<Processor> cpus = sys.Cpus();
-    for (auto& cpu : cpus) {
+    for (auto& cpu : snap.cpus) {
       mvwprintw(win, ++row, col,
                 (kCpuCore + to_string(cpu.Id()) + ":").c_str());
       wattron(win, COLOR_PAIR(1));
       mvwprintw(win, row, col + 8, "");
       wprintw(win, ProgressBar(cpu.Utilization()).c_str());
       wattroff(win, COLOR_PAIR(1));
+      graph(cpu.Id() + 1);
     }
   }
 }
 
-void NCursesDisplay::MemoryBar(System& sys, WINDOW* win, int& row, int col) {
+void NCursesDisplay::MemoryBar(const Snapshot& snap, WINDOW* win, int& row,
+                               int col) {
   mvwprintw(win, row, col, kMemory.c_str());
   wattron(win, COLOR_PAIR(1));
   mvwprintw(win, row, col + 8, "");  // Tab
-  wprintw(win, ProgressBar(sys.MemoryUtilization()).c_str());
+  wprintw(win, ProgressBar(snap.memory).c_str());
   wattroff(win, COLOR_PAIR(1));
 }
 
@@ -257,35 +551,85 @@ void NCursesDisplay::ProcessMenu(System& sys, WINDOW* win, int& row, int col) {
   mvwprintw(win, row, col + sort_order.size() + 3, " ]");
 }
 
-void NCursesDisplay::ProcessInfo(System& sys, WINDOW* win, int& row, int col) {
-  std::string total = kTotal + to_string(sys.TotalProcesses());
-  std::string running = kRunning + to_string(sys.RunningProcesses());
-  std::string alive = kAlive + to_string(sys.Processes().size());
+void NCursesDisplay::ProcessInfo(System& sys, const Snapshot& snap,
+                                 WINDOW* win, int& row, int col) {
+  std::string total = kTotal + to_string(snap.total_processes);
+  std::string running = kRunning + to_string(snap.running_processes);
+  std::string alive = kAlive + to_string(snap.processes.size());
+  std::string exited = kExited + to_string(snap.exited.size());
+  // only the proc connector sees processes that exit within a tick
+  if (snap.process_events) {
+    exited += "  " + kShortLived + to_string(snap.short_lived);
+  }
+  // lines span the inside of the border, which starts at column 1
+  string line(std::max(win->_maxx - 1, 0), ' ');
   if (sys.ShowCores()) {
-    ClearLine(win, row);
-    mvwprintw(win, row, col, running.c_str());
-    mvwprintw(win, row, (win->_maxx - alive.size()) / 2, alive.c_str());
-    mvwprintw(win, row, win->_maxx - total.size() - 1, total.c_str());
+    std::string center = alive + "  " + exited;
+    Place(line, col - 1, running);
+    Place(line, (win->_maxx - center.size()) / 2 - 1, center);
+    Place(line, win->_maxx - total.size() - 2, total);
+    system_rows.Draw(win, row, 1, line);
   } else {
-    ClearLine(win, row);
-    mvwprintw(win, row, col, running.c_str());
-    mvwprintw(win, row, col + 2 + running.size(), alive.c_str());
-    ClearLine(win, ++row);
-    mvwprintw(win, row, col, total.c_str());
+    Place(line, col - 1, running);
+    Place(line, col + 1 + running.size(), alive);
+    system_rows.Draw(win, row, 1, line);
+    line.assign(line.size(), ' ');
+    Place(line, col - 1, total);
+    Place(line, col + 1 + total.size(), exited);
+    system_rows.Draw(win, ++row, 1, line);
   }
 }
 
-void NCursesDisplay::DisplaySystem(System& system, WINDOW* window) {
+void NCursesDisplay::DisplaySystem(System& system, const Snapshot& snapshot,
+                                   const History& history, WINDOW* window) {
   int row{0};
   int x_max = getmaxx(window);
-  SystemMenu(system, window, row, x_max - 26);
-  SystemInfo(system, window, ++row, 2);
-  CpuBars(system, window, ++row, 2);
-  MemoryBar(system, window, ++row, 2);
-  ProcessInfo(system, window, ++row, 2);
+  SystemMenu(system, window, row, x_max - 27);
+  SystemInfo(system, snapshot, window, ++row, 2);
+  CpuBars(system, snapshot, history, window, ++row, 2);
+  MemoryBar(snapshot, window, ++row, 2);
+  ProcessInfo(system, snapshot, window, ++row, 2);
+}
+
+/*
+ * Writes the monitor's own timings per phase over the last ticks, and its cpu
+ * utilization and memory, over the bottom border of window.
+ */
+void NCursesDisplay::DisplayTimings(System& system, WINDOW* window) {
+  const Instrumentation& timings = system.Timings();
+  string line = "[ " + kTimings;
+  char value[64];
+  for (int phase = 0; phase < Instrumentation::kTotalPhases_; phase++) {
+    Instrumentation::Summary summary =
+        timings.Percentiles((Instrumentation::Phase_t)phase);
+    snprintf(value, sizeof(value), "%s %.2f/%.2f  ",
+             Instrumentation::Name((Instrumentation::Phase_t)phase).c_str(),
+             summary.p50, summary.p99);
+    line += value;
+  }
+  snprintf(value, sizeof(value), "%.1f%% %.1f MB ]",
+           timings.SelfCpu() * 100, timings.SelfRam() / 1000.0);
+  line += kSelf + value;
+  int max_x = getmaxx(window);
+  if (max_x < 4) {
+    return;
+  }
+  wattron(window, COLOR_PAIR(1));
+  mvwprintw(window, getmaxy(window) - 1, 2, "%s",
+            line.substr(0, max_x - 4).c_str());
+  wattroff(window, COLOR_PAIR(1));
 }
 
-void NCursesDisplay::DisplayProcesses(System& system, WINDOW* window, int n) {
+/*
+ * order holds indexes into snapshot.processes, sorted at least as far as the n
+ * rows shown from viewport.top. The graph column shows the recent RAM of each
+ * process when sorting by RAM, and its CPU% otherwise.
+ */
+void NCursesDisplay::DisplayProcesses(System& system, const Snapshot& snapshot,
+                                      const std::vector<unsigned int>& order,
+                                      const History& history,
+                                      const Viewport& viewport, WINDOW* window,
+                                      int n) {
   int row{0};
   int const pid_column{2};
   int const user_column{10};
@@ -293,10 +637,27 @@ void NCursesDisplay::DisplayProcesses(System& system, WINDOW* window, int n) {
   int const cpu_column{21};
   int const ram_column{27};
   int const time_column{36};
-  int const command_column{47};
+  // the graph column, when shown, moves the command to the right
+  int const graph_column{47};
+  int const command_column{
+      system.ShowHistory() ? graph_column + GRAPH_COLUMN_WIDTH + 2 : 47};
+  bool const graph_ram = system.Sort() == System::kRam_;
   int max_x = getmaxx(window);
 
   ProcessMenu(system, window, row, max_x - 21);
+  // processes shown out of all of them, over the top border. With threads
+  // shown, fewer processes than rows fit.
+  const std::vector<Process>& processes = snapshot.processes;
+  size_t count = order.size();
+  size_t last = viewport.top;
+  for (size_t rows = 0; last < order.size() && rows < (size_t)std::max(n, 0);
+       last++) {
+    rows += ProcessRows(snapshot, processes[order[last]].Pid());
+  }
+  string range = "[ " + to_string(count == 0 ? 0 : viewport.top + 1) + "-" +
+                 to_string(std::min(count, last)) + "/" + to_string(count) +
+                 " ]";
+  mvwaddstr(window, row, 2, range.c_str());
 
   // Column headings
   int color = system.Sort() == System::kPid_ ? 4 : 3;
@@ -313,38 +674,114 @@ void NCursesDisplay::DisplayProcesses(System& system, WINDOW* window, int n) {
   BoldUnderlineAndColor(window, color, row, time_column, kTime);
   color = system.Sort() == System::kCommand_ ? 4 : 3;
   BoldUnderlineAndColor(window, color, row, command_column, kCommand, 1);
+  if (system.ShowHistory()) {
+    BoldUnderlineAndColor(window, 3, row, graph_column,
+                          graph_ram ? kRamGraph : kCpuGraph, 4);
+  }
 
   // Processes
-  std::vector<Process> processes = system.Processes();
+  // values are stored as numbers, and only formatted here for the rows drawn.
+  // Each row is formatted in full, inside the border, and only the characters
+  // that changed since the last frame are written to the window. Threads
+  // follow their process, busiest first, with their thread id as the pid. In
+  // the tree, node holds the totals of the subtree of the process, which are
+  // shown instead of its own, and the depth its command is indented by.
+  bool tree = system.ShowTree() && !snapshot.tree.empty();
+  const TreeNode* node = nullptr;
+  auto format = [&](string& line, const Process& process, bool thread) {
+    Place(line, pid_column - 1, to_string(process.Pid()));
+    Place(
+        line, user_column - 1,
+        string_view(process.User()).substr(0, state_column - user_column - 2));
+    char state = process.State();
+    Place(line, state_column - 1, string_view(&state, 1));
+    bool total = node && !thread;
+    float cpu = (total ? node->cpu : process.CpuUtilization()) * 100;
+    Place(line, cpu_column - 1, to_string(cpu).substr(0, 4));
+    if (!thread) {
+      float ram = (total ? node->ram : process.Ram()) / 1000.0;
+      Place(line, ram_column - 1, to_string(ram).substr(0, 7));
+    }
+    Place(line, time_column - 1, Format::ElapsedTime(process.UpTime()));
+    if (system.ShowHistory() && !thread) {
+      float high = 1.0;  // one cpu, or more for a process using several
+      if (graph_ram) {
+        history.ProcessRam(process, GRAPH_COLUMN_WIDTH, graph_samples);
+        high = 0.0;  // the highest RAM shown
+      } else {
+        history.ProcessCpu(process, GRAPH_COLUMN_WIDTH, graph_samples);
+      }
+      for (float sample : graph_samples) {
+        high = std::max(high, sample);
+      }
+      Place(line, graph_column - 1,
+            Sparkline(graph_samples, high, GRAPH_COLUMN_WIDTH));
+    }
+    string command(node ? 2 * node->depth : 0, ' ');
+    if (thread) {
+      command += kThreadPrefix + process.Command();
+    } else {
+      if (node && node->descendants > 0) {
+        command += std::binary_search(viewport.collapsed.begin(),
+                                      viewport.collapsed.end(), process.Pid())
+                       ? kCollapsed
+                       : kExpanded;
+      }
+      int width = window->_maxx - command_column - 1 - (int)command.size();
+      command += process.Command(std::max(width, 1));
+    }
+    Place(line, command_column - 1, command);
+  };
+  string line;
+  size_t index = viewport.top;
   for (int i = 0; i < n; ++i) {
-    ClearLine(window, ++row);
-
-    if ((size_t)i > processes.size() - 1) {
+    line.assign(std::max(window->_maxx - 1, 0), ' ');
+    if (!thread_rows.empty()) {
+      format(line, *thread_rows.back(), true);
+      thread_rows.pop_back();
+      process_rows_drawn.Draw(window, ++row, 1, line);
       continue;
     }
-
-    mvwprintw(window, row, pid_column, to_string(processes[i].Pid()).c_str());
-    mvwprintw(
-        window, row, user_column,
-        processes[i].User().substr(0, state_column - user_column - 2).c_str());
-    mvwprintw(window, row, state_column, processes[i].State().c_str());
-    float cpu = processes[i].CpuUtilization() * 100;
-    mvwprintw(window, row, cpu_column, to_string(cpu).substr(0, 4).c_str());
-    mvwprintw(window, row, ram_column, processes[i].Ram().substr(0, 7).c_str());
-    mvwprintw(window, row, time_column,
-              Format::ElapsedTime(processes[i].UpTime()).c_str());
-    mvwprintw(window, row, command_column,
-              processes[i].Command(window->_maxx - command_column - 1).c_str());
+    if (index < order.size()) {
+      const Process& process = processes[order[index]];
+      node = tree ? &snapshot.tree[order[index]] : nullptr;
+      format(line, process, false);
+      for (auto thread = FirstThread(snapshot, process.Pid());
+           thread != snapshot.threads.end() &&
+           thread->Tgid() == process.Pid();
+           thread++) {
+        thread_rows.emplace_back(&*thread);
+      }
+      // popped from the back, so the busiest thread goes last
+      std::sort(thread_rows.begin(), thread_rows.end(),
+                [](const Process* a, const Process* b) {
+                  if (a->CpuUtilization() != b->CpuUtilization()) {
+                    return a->CpuUtilization() < b->CpuUtilization();
+                  }
+                  return a->Pid() > b->Pid();
+                });
+    }
+    process_rows_drawn.Draw(window, ++row, 1, line,
+                            index == viewport.selected && index < order.size()
+                                ? A_REVERSE
+                                : A_NORMAL);
+    index++;
   }
+  thread_rows.clear();
 }
 
-void NCursesDisplay::Display(System& system) {
-  initscr();              // start ncurses
-  noecho();               // do not print input values
-  cbreak();               // terminate ncurses on ctrl + c
-  start_color();          // enable color
-  curs_set(0);            // hide cursor
-  nodelay(stdscr, TRUE);  // make getch() non-blocking
+/*
+ * Shows the snapshots published by source, a Sampler of system or a Replayer.
+ * Keys the display does not use are passed on to source.
+ */
+void NCursesDisplay::Display(System& system, SnapshotSource& source) {
+  initscr();               // start ncurses
+  noecho();                // do not print input values
+  cbreak();                // terminate ncurses on ctrl + c
+  start_color();           // enable color
+  curs_set(0);             // hide cursor
+  nodelay(stdscr, TRUE);   // make getch() non-blocking
+  keypad(stdscr, TRUE);    // report arrow and paging keys as KEY_*
 
   init_pair(1, COLOR_BLUE, COLOR_BLACK);
   init_pair(2, COLOR_RED, COLOR_BLACK);
@@ -360,18 +797,91 @@ void NCursesDisplay::Display(System& system) {
 
   int process_rows = y_max - system_window->_maxy - 4;
 
-  while (1) {
-    CheckEvents(system, system_window, process_window, process_rows);
-    box(process_window, 0, 0);
-    box(system_window, 0, 0);
-    system.UpdateProcesses();
-    system.UpdateProcessors();
-    DisplayProcesses(system, process_window, process_rows);
-    DisplaySystem(system, system_window);
-    wrefresh(process_window);
-    wrefresh(system_window);
-    refresh();
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+  // Sampling runs on its own thread. This loop sleeps in poll() until a key
+  // is pressed, a new snapshot has been published, or the terminal has been
+  // resized, and re-sorts the latest snapshot on every redraw so a new sort
+  // order shows immediately.
+  int signal_fd = WindowSizeSignalFd();
+  source.Start();
+  ProcessSorter sorter;
+  Instrumentation& timings = system.Timings();
+  std::shared_ptr<const Snapshot> snapshot;
+  std::vector<unsigned int> visible;
+  Viewport viewport;
+  History history(system.TotalCpus());
+  unsigned long history_tick = 0;  // of the last snapshot added to history
+  struct pollfd fds[3] = {{STDIN_FILENO, POLLIN, 0},
+                          {source.ReadyFd(), POLLIN, 0},
+                          {signal_fd, POLLIN, 0}};
+  bool quit = false;
+  while (!quit) {
+    if (poll(fds, signal_fd < 0 ? 2 : 3, -1) < 0) {
+      continue;
+    }
+    if (fds[0].revents & POLLIN) {
+      int ch;
+      while ((ch = CheckEvents(system, system_window, process_window,
+                               process_rows, viewport)) != ERR) {
+        quit = quit || ch == 'q' || ch == 'Q';
+        source.Key(ch);
+      }
+    }
+    if (fds[1].revents & POLLIN) {
+      source.ClearReady();
+    }
+    if (signal_fd >= 0 && fds[2].revents & POLLIN) {
+      ResizeTerminal(signal_fd);
+      Resize(system, system_window, process_window, process_rows);
+    }
+    if (quit) {
+      break;
+    }
+    snapshot = source.Latest();
+    {
+      ScopedTimer timer(timings, Instrumentation::kSort_);
+      PlaceViewport(system, *snapshot, sorter, viewport, process_rows);
+      // rows on screen, and a page either side of them, are sampled every
+      // tick in full, however idle the process is
+      size_t rows = std::max(process_rows, 0);
+      size_t first = viewport.top - std::min(viewport.top, rows);
+      size_t last = std::min(sorter.Order().size(), viewport.top + 2 * rows);
+      visible.clear();
+      for (size_t i = first; i < last; i++) {
+        visible.emplace_back(snapshot->processes[sorter.Order()[i]].Pid());
+      }
+      system.SetVisiblePids(visible);
+      // the cpus, and the processes near the screen, once per snapshot
+      if (snapshot->tick != history_tick) {
+        history_tick = snapshot->tick;
+        history.AddCpus(snapshot->cpu, snapshot->cpus);
+        for (size_t i = first; i < last; i++) {
+          history.AddProcess(snapshot->processes[sorter.Order()[i]]);
+        }
+      }
+    }
+    {
+      ScopedTimer timer(timings, Instrumentation::kRender_);
+      box(process_window, 0, 0);
+      box(system_window, 0, 0);
+      DisplayProcesses(system, *snapshot, sorter.Order(), history, viewport,
+                       process_window, process_rows);
+      DisplaySystem(system, *snapshot, history, system_window);
+      if (system.ShowTimings()) {
+        timings.UpdateSelf();
+        DisplayTimings(system, process_window);
+      }
+    }
+    {
+      ScopedTimer timer(timings, Instrumentation::kRefresh_);
+      wrefresh(process_window);
+      wrefresh(system_window);
+      refresh();
+    }
+    timings.EndTick(Instrumentation::kSort_, Instrumentation::kRefresh_);
+  }
+  source.Stop();
+  if (signal_fd >= 0) {
+    close(signal_fd);
   }
   endwin();
 }
\ No newline at end of file
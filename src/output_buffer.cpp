@@ -0,0 +1,189 @@
+#include "output_buffer.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <string_view>
+
+using std::string_view;
+
+OutputBuffer::OutputBuffer(int fd, size_t capacity)
+    : fd_(fd), buffer_(capacity) {}
+
+OutputBuffer::~OutputBuffer() { Flush(); }
+
+/*
+ * Writes out everything appended so far. Returns false once a write has
+ * failed, after which output is discarded.
+ */
+bool OutputBuffer::Flush() {
+  size_t written = 0;
+  while (!failed_ && written < size_) {
+    ssize_t n = write(fd_, buffer_.data() + written, size_ - written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      failed_ = true;
+    } else {
+      written += n;
+    }
+  }
+  size_ = 0;
+  return !failed_;
+}
+
+/*
+ * Returns room for at least n more characters at the end of the buffer,
+ * flushing it first if necessary. n must not exceed the capacity.
+ */
+char* OutputBuffer::Reserve(size_t n) {
+  if (buffer_.size() - size_ < n) {
+    Flush();
+  }
+  return buffer_.data() + size_;
+}
+
+OutputBuffer& OutputBuffer::Append(string_view text) {
+  while (!text.empty()) {
+    size_t room = buffer_.size() - size_;
+    if (room == 0) {
+      Flush();
+      room = buffer_.size();
+    }
+    size_t n = std::min(room, text.size());
+    text.copy(buffer_.data() + size_, n);
+    size_ += n;
+    text.remove_prefix(n);
+  }
+  return *this;
+}
+
+OutputBuffer& OutputBuffer::Append(char c) {
+  *Reserve(1) = c;
+  size_++;
+  return *this;
+}
+
+/*
+ * Non-finite values have no JSON or CSV spelling, so they are written as 0.
+ */
+OutputBuffer& OutputBuffer::AppendFixed(double value, int precision) {
+  if (!std::isfinite(value)) {
+    value = 0.0;
+  }
+  // enough for the digits of any double plus a fraction of up to 16 digits
+  char* p = Reserve(NUMBER_CHARS + 310);
+  size_ = std::to_chars(p, buffer_.data() + buffer_.size(), value,
+                        std::chars_format::fixed, precision)
+              .ptr -
+          buffer_.data();
+  return *this;
+}
+
+namespace {
+/*
+ * The length of the well-formed UTF-8 sequence that starts text[i], a byte
+ * above 0x7f, or 0 if there is none. Overlong forms, surrogates and code
+ * points past U+10FFFF are not well-formed.
+ */
+size_t Utf8Length(string_view text, size_t i) {
+  unsigned char c = text[i];
+  size_t length;
+  unsigned char low = 0x80, high = 0xbf;  // bounds of the second byte
+  if (c >= 0xc2 && c <= 0xdf) {
+    length = 2;
+  } else if (c >= 0xe0 && c <= 0xef) {
+    length = 3;
+    low = c == 0xe0 ? 0xa0 : low;
+    high = c == 0xed ? 0x9f : high;
+  } else if (c >= 0xf0 && c <= 0xf4) {
+    length = 4;
+    low = c == 0xf0 ? 0x90 : low;
+    high = c == 0xf4 ? 0x8f : high;
+  } else {
+    return 0;
+  }
+  if (text.size() - i < length) {
+    return 0;
+  }
+  for (size_t n = 1; n < length; n++) {
+    unsigned char next = text[i + n];
+    if (next < (n == 1 ? low : 0x80) || next > (n == 1 ? high : 0xbf)) {
+      return 0;
+    }
+  }
+  return length;
+}
+}  // namespace
+
+/*
+ * Appends text as a quoted JSON string. Command lines may hold anything, so
+ * quotes, backslashes and control characters are escaped, and bytes that are
+ * not part of well-formed UTF-8 are written as U+FFFD, so the output is
+ * always valid JSON.
+ */
+OutputBuffer& OutputBuffer::AppendJson(string_view text) {
+  static const char kHex[] = "0123456789abcdef";
+  Append('"');
+  size_t start = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    unsigned char c = text[i];
+    if (c >= 0x80) {
+      size_t length = Utf8Length(text, i);
+      if (length > 0) {
+        i += length - 1;
+        continue;
+      }
+      Append(text.substr(start, i - start)).Append("\\ufffd");
+      start = i + 1;
+      continue;
+    }
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    Append(text.substr(start, i - start));
+    start = i + 1;
+    switch (c) {
+      case '"':
+        Append("\\\"");
+        break;
+      case '\\':
+        Append("\\\\");
+        break;
+      case '\n':
+        Append("\\n");
+        break;
+      case '\t':
+        Append("\\t");
+        break;
+      default:
+        Append("\\u00").Append(kHex[c >> 4]).Append(kHex[c & 0xf]);
+        break;
+    }
+  }
+  Append(text.substr(start));
+  return Append('"');
+}
+
+/*
+ * Appends text as a CSV field, quoted and with doubled quotes when it holds a
+ * separator, a quote or a line break.
+ */
+OutputBuffer& OutputBuffer::AppendCsv(string_view text) {
+  if (text.find_first_of(",\"\r\n") == string_view::npos) {
+    return Append(text);
+  }
+  Append('"');
+  size_t start = 0;
+  for (size_t quote = text.find('"'); quote != string_view::npos;
+       quote = text.find('"', start)) {
+    Append(text.substr(start, quote + 1 - start)).Append('"');
+    start = quote + 1;
+  }
+  Append(text.substr(start));
+  return Append('"');
+}
@@ -0,0 +1,114 @@
+#include "pid_scanner.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define DIRENT_BUFFER_SIZE (32 * 1024)
+
+namespace {
+// the record returned by getdents64(), which glibc does not declare
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+}  // namespace
+
+PidScanner::PidScanner(string path)
+    : path_(std::move(path)), buffer_(DIRENT_BUFFER_SIZE) {
+  Open();
+}
+
+PidScanner::~PidScanner() { Close(); }
+
+bool PidScanner::IsOpen() const { return fd_ >= 0; }
+
+// an empty path leaves the scanner closed, so that it finds no pid
+void PidScanner::Open() {
+  if (!path_.empty()) {
+    fd_ = open(path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+}
+
+void PidScanner::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+/*
+ * Replaces the contents of pids with the numeric directories in the scanned
+ * directory, in the order the kernel lists them, which for /proc is ascending.
+ * pids is left empty if the directory cannot be read.
+ */
+void PidScanner::Scan(vector<unsigned int>& pids) {
+  pids.clear();
+  if (!IsOpen()) {
+    Open();
+    if (!IsOpen()) {
+      return;
+    }
+  }
+  if (lseek(fd_, 0, SEEK_SET) < 0) {
+    return;
+  }
+  ReadEntries(fd_, pids);
+}
+
+/*
+ * Replaces the contents of ids with the numeric directories in path, such as
+ * the thread ids in /proc/[pid]/task, reusing the scanner's buffer. The
+ * directory is opened for this call only.
+ */
+void PidScanner::Scan(const char* path, vector<unsigned int>& ids) {
+  ids.clear();
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  ReadEntries(fd, ids);
+  close(fd);
+}
+
+void PidScanner::ReadEntries(int fd, vector<unsigned int>& ids) {
+  while (true) {
+    long n = syscall(SYS_getdents64, fd, buffer_.data(), buffer_.size());
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    for (long offset = 0; offset < n;) {
+      const LinuxDirent64* entry =
+          reinterpret_cast<const LinuxDirent64*>(buffer_.data() + offset);
+      offset += entry->d_reclen;
+      if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) {
+        continue;
+      }
+      const char* name = entry->d_name;
+      const char* end = name + strlen(name);
+      unsigned int id;
+      auto result = std::from_chars(name, end, id);
+      if (result.ec == std::errc() && result.ptr == end && name != end) {
+        ids.emplace_back(id);
+      }
+    }
+  }
+}
@@ -0,0 +1,183 @@
+#include "proc_events.h"
+
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+using std::vector;
+
+#define EVENT_BUFFER_SIZE (64 * 1024)    // bytes read per recv()
+#define SOCKET_BUFFER_SIZE (1024 * 1024)  // bytes queued between two ticks
+
+ProcEvents::ProcEvents() : buffer_(EVENT_BUFFER_SIZE) { Open(); }
+
+ProcEvents::~ProcEvents() { Close(); }
+
+bool ProcEvents::IsOpen() const { return fd_ >= 0; }
+
+/*
+ * Processes that were born and exited between two calls to Update(), which a
+ * scan of /proc would never have seen.
+ */
+unsigned long ProcEvents::ShortLived() const { return short_lived_; }
+
+/*
+ * Binds a non-blocking netlink socket to the proc connector and asks the
+ * kernel to start multicasting events to it. The socket is closed again if
+ * any step fails, which is the common case when not running as root.
+ */
+void ProcEvents::Open() {
+  fd_ = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+               NETLINK_CONNECTOR);
+  if (fd_ < 0) {
+    return;
+  }
+  int size = SOCKET_BUFFER_SIZE;
+  setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  struct sockaddr_nl address {};
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = CN_IDX_PROC;
+  if (bind(fd_, (struct sockaddr*)&address, sizeof(address)) < 0) {
+    Close();
+    return;
+  }
+
+  enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+  alignas(struct nlmsghdr) char
+      message[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(op))] = {};
+  struct nlmsghdr* header = (struct nlmsghdr*)message;
+  header->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+  header->nlmsg_type = NLMSG_DONE;
+  struct cn_msg* connector = (struct cn_msg*)NLMSG_DATA(header);
+  connector->id.idx = CN_IDX_PROC;
+  connector->id.val = CN_VAL_PROC;
+  connector->len = sizeof(op);
+  memcpy(connector->data, &op, sizeof(op));
+  if (send(fd_, message, header->nlmsg_len, 0) < 0) {
+    Close();
+  }
+}
+
+void ProcEvents::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+/*
+ * Appends every queued event to events_. Events of individual threads are
+ * dropped, only the thread group leader stands for a process. Returns false
+ * if the socket overflowed and events were lost.
+ */
+bool ProcEvents::Receive() {
+  while (true) {
+    ssize_t n = recv(fd_, buffer_.data(), buffer_.size(), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    size_t length = n;
+    for (struct nlmsghdr* header = (struct nlmsghdr*)buffer_.data();
+         NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+      if (header->nlmsg_type == NLMSG_ERROR ||
+          header->nlmsg_type == NLMSG_NOOP) {
+        continue;
+      }
+      struct cn_msg* connector = (struct cn_msg*)NLMSG_DATA(header);
+      if (connector->id.idx != CN_IDX_PROC ||
+          connector->id.val != CN_VAL_PROC) {
+        continue;
+      }
+      struct proc_event* event = (struct proc_event*)connector->data;
+      switch (event->what) {
+        case proc_event::PROC_EVENT_FORK:
+          if (event->event_data.fork.child_pid ==
+              event->event_data.fork.child_tgid) {
+            events_.push_back({(unsigned int)event->event_data.fork.child_pid,
+                               kFork});
+          }
+          break;
+        case proc_event::PROC_EVENT_EXEC:
+          events_.push_back(
+              {(unsigned int)event->event_data.exec.process_tgid, kExec});
+          break;
+        case proc_event::PROC_EVENT_EXIT:
+          if (event->event_data.exit.process_pid ==
+              event->event_data.exit.process_tgid) {
+            events_.push_back(
+                {(unsigned int)event->event_data.exit.process_pid, kExit});
+          }
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+/*
+ * Applies the events received since the last call to pids, which is sorted,
+ * and fills execs with the sorted pids that have executed a new program. The
+ * events are grouped by pid, keeping the order they arrived in, so a pid that
+ * was reused within a tick ends up in the state of its last event. A single
+ * merge with pids then applies every group in linear time.
+ *
+ * Returns false if events were lost, in which case pids is left untouched and
+ * has to be rebuilt from a scan of /proc.
+ */
+bool ProcEvents::Update(vector<unsigned int>& pids,
+                        vector<unsigned int>& execs) {
+  execs.clear();
+  events_.clear();
+  if (!Receive()) {
+    events_.clear();
+    return false;
+  }
+  std::stable_sort(
+      events_.begin(), events_.end(),
+      [](const Event& a, const Event& b) { return a.pid < b.pid; });
+
+  merged_.clear();
+  auto pid = pids.begin();
+  auto group = events_.begin();
+  while (group != events_.end()) {
+    unsigned int current = group->pid;
+    bool forked = false;
+    bool executed = false;
+    Kind last = group->kind;
+    for (; group != events_.end() && group->pid == current; group++) {
+      if (group->kind == kExit && forked) {
+        short_lived_++;
+      }
+      forked = group->kind == kFork || (forked && group->kind == kExec);
+      executed = executed || group->kind == kExec;
+      last = group->kind;
+    }
+    while (pid != pids.end() && *pid < current) {
+      merged_.emplace_back(*pid++);
+    }
+    if (pid != pids.end() && *pid == current) {
+      pid++;
+    }
+    if (last != kExit) {
+      merged_.emplace_back(current);
+      if (executed) {
+        execs.emplace_back(current);
+      }
+    }
+  }
+  merged_.insert(merged_.end(), pid, pids.end());
+  pids.swap(merged_);
+  return true;
+}
@@ -0,0 +1,82 @@
+#include "proc_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using std::string;
+using std::string_view;
+
+ProcFile::ProcFile(string path) : path_(std::move(path)), buffer_(4096) {
+  Open();
+}
+
+ProcFile::ProcFile(ProcFile&& other) noexcept
+    : path_(std::move(other.path_)),
+      fd_(other.fd_),
+      buffer_(std::move(other.buffer_)) {
+  other.fd_ = -1;
+}
+
+ProcFile& ProcFile::operator=(ProcFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    path_ = std::move(other.path_);
+    fd_ = other.fd_;
+    buffer_ = std::move(other.buffer_);
+    other.fd_ = -1;
+  }
+  return *this;
+}
+
+ProcFile::~ProcFile() { Close(); }
+
+const string& ProcFile::Path() const { return path_; }
+bool ProcFile::IsOpen() const { return fd_ >= 0; }
+
+// an empty path leaves the handle closed, and every Read() empty
+void ProcFile::Open() {
+  if (!path_.empty()) {
+    fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+}
+
+void ProcFile::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+/*
+ * Re-reads the whole file from offset 0 in a single pread(), so the contents
+ * are one consistent snapshot. If the file fills the buffer, the buffer is
+ * doubled and the read is retried, so once it has grown to size a read does
+ * not allocate. If the file could not be opened earlier, opening it is
+ * retried here, and an empty view is returned while it stays unavailable.
+ */
+string_view ProcFile::Read() {
+  if (!IsOpen()) {
+    Open();
+    if (!IsOpen()) {
+      return string_view();
+    }
+  }
+  while (true) {
+    ssize_t n = pread(fd_, buffer_.data(), buffer_.size(), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      return string_view();
+    }
+    if ((size_t)n < buffer_.size()) {
+      return string_view(buffer_.data(), n);
+    }
+    buffer_.resize(buffer_.size() * 2);
+  }
+}
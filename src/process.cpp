@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <cctype>
 #include <iomanip>
 #include <sstream>
@@ -14,16 +15,30 @@ using std::string;
 using std::to_string;
 using std::vector;
 
-Process::Process(unsigned int pid, string user, string command)
-    : pid_(pid), user_(user), command_(command) {
-  active_ = LinuxParser::ActiveJiffies(pid);
-  uptime_ = LinuxParser::UpTime(pid);
+// an idle process is read at most every 2^MAX_IDLE_SHIFT ticks
+#define MAX_IDLE_SHIFT 5
+
+/*
+ * A non-zero tgid makes this one of the threads of process tgid, with pid as
+ * its thread id, read from /proc/[tgid]/task/[pid] instead of /proc/[pid].
+ */
+Process::Process(unsigned int pid, string user, string command,
+                 unsigned int tgid)
+    : pid_(pid), tgid_(tgid), user_(user), command_(command) {
+  // active_ and sampled_ start at zero, so the first Update() reports the
+  // average utilization over the lifetime of the process
+  active_ = 0;
+  uptime_ = 0;
   cpu_util_ = 0;
-  killed_ = false;
+  generation_ = 0;
 };
 
 unsigned int Process::Pid() const { return pid_; }
-string Process::User() const { return user_; }
+unsigned int Process::Tgid() const { return tgid_; }
+unsigned int Process::PPid() const { return ppid_; }
+long Process::Threads() const { return threads_; }
+const string& Process::User() const { return user_; }
+const string& Process::Command() const { return command_; }
 string Process::Command(unsigned int len) const {
   if (len > 0 && len <= 6) {
     return command_.substr(0, len);
@@ -34,49 +49,117 @@ string Process::Command(unsigned int len) const {
 }
 unsigned long Process::Active() const { return active_; }
 unsigned long Process::UpTime() const { return uptime_; }
+unsigned long long Process::StartTime() const { return starttime_; }
 float Process::CpuUtilization() const { return cpu_util_; }
-string Process::Ram() const { return ram_; }
-string Process::State() const { return state_; }
-bool Process::isKilled() const { return killed_; }
+unsigned long Process::Ram() const { return ram_; }
+bool Process::RamRead() const { return ram_read_; }
+char Process::State() const { return state_; }
+unsigned long Process::Generation() const { return generation_; }
+bool Process::Due(unsigned long generation) const {
+  return generation >= next_update_;
+}
+bool Process::isRecycled() const { return recycled_; }
 
 void Process::SetActive(unsigned long active) { active_ = active; }
 void Process::SetUpTime(unsigned long uptime) { uptime_ = uptime; }
 void Process::SetCpuUtilization(float cpu_util) { cpu_util_ = cpu_util; }
-void Process::SetRam(string ram) { ram_ = ram; }
-void Process::SetState(string state) { state_ = state; }
-void Process::SetKilled(bool k) { killed_ = k; }
-
-void Process::UpdateCpuUtilization() {
-  unsigned long active_now = LinuxParser::ActiveJiffies(Pid());
-  unsigned long uptime_now = LinuxParser::UpTime(Pid());
-  unsigned long uptime_d = uptime_now - uptime_;
-  if (uptime_d > 0) {
-    float active_d =
-        (float)(active_now - active_) / (float)sysconf(_SC_CLK_TCK);
+void Process::SetRam(unsigned long ram) {
+  ram_ = ram;
+  ram_read_ = true;
+}
+void Process::SetState(char state) { state_ = state; }
+void Process::MarkSeen(unsigned long generation) { generation_ = generation; }
+void Process::SetRecycled(bool r) { recycled_ = r; }
+
+/*
+ * uptime is the system uptime in seconds, read once per tick by the caller.
+ * Utilization is averaged over the time since the previous read, which may
+ * span several ticks for an idle process.
+ */
+void Process::UpdateCpuUtilization(const PidStat& stat, double uptime) {
+  long ticks = sysconf(_SC_CLK_TCK);
+  unsigned long active_now = stat.utime + stat.stime;
+  double start = (double)stat.starttime / ticks;
+  double since = sampled_ > 0.0 ? sampled_ : start;
+  SetUpTime(uptime > start ? uptime - start : 0);
+  if (uptime > since) {
+    float active_d = (float)(active_now - active_) / (float)ticks;
     SetActive(active_now);
-    SetUpTime(uptime_now);
-    SetCpuUtilization(active_d / (float)uptime_d);
+    SetCpuUtilization(active_d / (float)(uptime - since));
+    sampled_ = uptime;
   }
 }
 
+/*
+ * Sets the fields shown by the display from a recording, for a process that is
+ * replayed rather than read from /proc.
+ */
+void Process::Restore(char state, float cpu_util, unsigned long ram,
+                      unsigned long uptime) {
+  SetState(state);
+  SetCpuUtilization(cpu_util);
+  SetRam(ram);
+  SetUpTime(uptime);
+}
+
+/*
+ * Refreshes the age of the process without reading anything, for ticks on
+ * which it is not due to be read.
+ */
+void Process::UpdateUpTime(double uptime) {
+  double start = (double)starttime_ / sysconf(_SC_CLK_TCK);
+  SetUpTime(uptime > start ? uptime - start : 0);
+}
+
+/*
+ * A sleeping process that used no cpu since its last read is read again after
+ * 2, 4, 8, ... ticks, up to 2^MAX_IDLE_SHIFT. Any other process is read on
+ * every tick.
+ */
+void Process::UpdateSchedule(const PidStat& stat, unsigned long active,
+                             unsigned long generation) {
+  bool idle = (stat.state == 'S' || stat.state == 'I') && Active() == active;
+  idle_ticks_ = idle ? std::min(idle_ticks_ + 1, (unsigned int)MAX_IDLE_SHIFT)
+                     : 0;
+  next_update_ = generation + (1UL << idle_ticks_);
+}
+
 void Process::UpdateRam() { SetRam(LinuxParser::Ram(Pid())); }
 
-void Process::UpdateState() {
-  string state = LinuxParser::State(Pid());
-  if (state.empty()) {
-    // process state was not read from file, so this is a good indication that
-    // this proccess has been killed. Set killed_ to true and set state to "~"
-    // to allow for sorting by state to remove killed processes
-    SetKilled(true);
-    state = "~";
-  }
-  SetState(state);
+void Process::UpdateState(const PidStat& stat) {
+  SetState(stat.state);
+  threads_ = stat.threads;
+  ppid_ = stat.ppid;
 }
 
-void Process::Update() {
-  UpdateCpuUtilization();
-  UpdateRam();
-  UpdateState();
+/*
+ * generation identifies the current tick, and is used to schedule the next
+ * read. A process whose stat can no longer be read exited after the pid scan,
+ * so it is no longer marked as seen. Without detail only /proc/[pid]/stat is
+ * read, and the RAM from /proc/[pid]/status keeps its last value.
+ */
+void Process::Update(double uptime, unsigned long generation, bool detail) {
+  PidStat stat;
+  bool read = tgid_ != 0 ? LinuxParser::ReadTaskStat(tgid_, Pid(), stat)
+                         : LinuxParser::ReadPidStat(Pid(), stat);
+  if (!read) {
+    MarkSeen(0);
+    return;
+  }
+  if (starttime_ != 0 && stat.starttime != starttime_) {
+    // the pid now belongs to a different process that was started since the
+    // last update, so none of the values held here apply to it
+    SetRecycled(true);
+    return;
+  }
+  starttime_ = stat.starttime;
+  unsigned long active = Active();
+  UpdateCpuUtilization(stat, uptime);
+  if (detail) {
+    UpdateRam();
+  }
+  UpdateState(stat);
+  UpdateSchedule(stat, active, generation);
 }
 
 bool Process::operator<(Process const& a) const {
@@ -0,0 +1,131 @@
+#include "process_sorter.h"
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+#include "process.h"
+#include "process_tree.h"
+#include "system.h"
+
+using std::vector;
+
+namespace {
+/*
+ * Orders sort keys by their value, breaking ties by index so that equal keys
+ * keep a stable order from one tick to the next. The direction is a template
+ * parameter, so the comparison is inlined into the sort.
+ */
+template <bool Descending>
+struct KeyOrder {
+  template <typename Key>
+  bool operator()(const Key& a, const Key& b) const {
+    if (a.first != b.first) {
+      return Descending ? b.first < a.first : a.first < b.first;
+    }
+    return a.second < b.second;
+  }
+};
+
+/*
+ * Only the first n keys are put in order, unless n is 0 or covers every key.
+ */
+template <typename Key, typename Compare>
+void SortWindow(vector<Key>& keys, size_t n, Compare compare) {
+  if (n == 0 || n >= keys.size()) {
+    std::sort(keys.begin(), keys.end(), compare);
+  } else {
+    std::partial_sort(keys.begin(), keys.begin() + n, keys.end(), compare);
+  }
+}
+}  // namespace
+
+const vector<unsigned int>& ProcessSorter::Order() const { return order_; }
+
+/*
+ * Computes one key per process with extract, sorts the keys, and stores the
+ * resulting process indexes in order_.
+ */
+template <typename Key, typename Extract>
+void ProcessSorter::SortBy(const vector<Process>& processes, vector<Key>& keys,
+                           bool descending, size_t visible, Extract extract) {
+  keys.clear();
+  for (unsigned int i = 0; i < processes.size(); i++) {
+    keys.emplace_back(extract(processes[i]), i);
+  }
+  if (descending) {
+    SortWindow(keys, visible, KeyOrder<true>());
+  } else {
+    SortWindow(keys, visible, KeyOrder<false>());
+  }
+  order_.clear();
+  for (auto& key : keys) {
+    order_.emplace_back(key.second);
+  }
+}
+
+/*
+ * Numeric columns share a double key, which holds every pid, state,
+ * utilization, RAM and uptime value exactly. Text columns are compared through
+ * views of the strings held by each Process, so nothing is copied.
+ */
+const vector<unsigned int>& ProcessSorter::Sort(
+    const vector<Process>& processes, System::Sort_t sort, bool descending,
+    size_t visible) {
+  auto& p = processes;
+  bool d = descending;
+  size_t n = visible;
+  switch (sort) {
+    case System::kPid_:
+      SortBy(p, numeric_keys_, d, n,
+             [](const Process& a) { return (double)a.Pid(); });
+      break;
+    case System::kUser_:
+      SortBy(p, text_keys_, d, n,
+             [](const Process& a) -> std::string_view { return a.User(); });
+      break;
+    case System::kState_:
+      SortBy(p, numeric_keys_, d, n,
+             [](const Process& a) { return (double)a.State(); });
+      break;
+    default:
+    case System::kCpu_:
+      SortBy(p, numeric_keys_, d, n,
+             [](const Process& a) { return (double)a.CpuUtilization(); });
+      break;
+    case System::kRam_:
+      SortBy(p, numeric_keys_, d, n,
+             [](const Process& a) { return (double)a.Ram(); });
+      break;
+    case System::kUpTime_:
+      SortBy(p, numeric_keys_, d, n,
+             [](const Process& a) { return (double)a.UpTime(); });
+      break;
+    case System::kCommand_:
+      SortBy(p, text_keys_, d, n,
+             [](const Process& a) -> std::string_view { return a.Command(); });
+      break;
+  }
+  return order_;
+}
+
+/*
+ * Copies tree_order, the depth first order of the tree, to the index, leaving
+ * out the descendants of every process in collapsed, a sorted list of pids.
+ * They follow the collapsed process, so they are skipped in one step, and
+ * collapsing or expanding a subtree does not wait for the next tick.
+ */
+const vector<unsigned int>& ProcessSorter::Tree(
+    const vector<Process>& processes, const vector<unsigned int>& tree_order,
+    const vector<TreeNode>& tree, const vector<unsigned int>& collapsed) {
+  order_.clear();
+  for (size_t i = 0; i < tree_order.size();) {
+    unsigned int index = tree_order[i];
+    order_.emplace_back(index);
+    bool hidden = !collapsed.empty() &&
+                  std::binary_search(collapsed.begin(), collapsed.end(),
+                                     processes[index].Pid());
+    i += hidden ? tree[index].descendants + 1 : 1;
+  }
+  return order_;
+}
@@ -0,0 +1,157 @@
+#include "process_tree.h"
+
+#include <vector>
+
+#include "process.h"
+
+using std::vector;
+
+ProcessTree::ProcessTree() { Clear(); }
+
+void ProcessTree::Clear() {
+  links_.assign(1, Link());
+  free_.clear();
+  slots_.clear();
+}
+
+// unlinks slot from the children of its parent, if it has one
+void ProcessTree::Detach(int slot) {
+  Link& link = links_[slot];
+  if (link.parent < 0) {
+    return;
+  }
+  Link& parent = links_[link.parent];
+  (link.prev >= 0 ? links_[link.prev].next : parent.first_child) = link.next;
+  (link.next >= 0 ? links_[link.next].prev : parent.last_child) = link.prev;
+  link.parent = link.prev = link.next = -1;
+}
+
+/*
+ * Links slot as a child of parent, in pid order. A new process usually has
+ * the highest pid so far, so the search starts from the last child.
+ */
+void ProcessTree::Attach(int slot, int parent) {
+  Link& link = links_[slot];
+  Link& owner = links_[parent];
+  int after = owner.last_child;
+  while (after >= 0 && links_[after].pid > link.pid) {
+    after = links_[after].prev;
+  }
+  link.parent = parent;
+  link.prev = after;
+  link.next = after >= 0 ? links_[after].next : owner.first_child;
+  (after >= 0 ? links_[after].next : owner.first_child) = slot;
+  (link.next >= 0 ? links_[link.next].prev : owner.last_child) = slot;
+}
+
+/*
+ * Drops the processes that exited. Their children wait under the root until
+ * they are read again with the parent the kernel gave them.
+ */
+void ProcessTree::Remove(const vector<Process>& exited) {
+  for (const Process& process : exited) {
+    auto found = slots_.find(process.Pid());
+    if (found == slots_.end()) {
+      continue;
+    }
+    int slot = found->second;
+    Detach(slot);
+    while (links_[slot].first_child >= 0) {
+      int child = links_[slot].first_child;
+      Detach(child);
+      Attach(child, 0);
+    }
+    links_[slot] = Link();
+    free_.emplace_back(slot);
+    slots_.erase(found);
+  }
+}
+
+/*
+ * processes is the live list of this tick, after Remove() was given the
+ * processes that exited. New processes, and those whose parent pid changed,
+ * are linked once every process has a slot, so a parent listed after its
+ * child is found. A parent that is not listed, such as the pid 0 of init and
+ * kthreadd, puts the process under the root.
+ */
+void ProcessTree::Update(const vector<Process>& processes) {
+  relink_.clear();
+  for (unsigned int i = 0; i < processes.size(); i++) {
+    const Process& process = processes[i];
+    auto [found, added] = slots_.try_emplace(process.Pid(), 0);
+    if (added) {
+      if (free_.empty()) {
+        found->second = links_.size();
+        links_.emplace_back();
+      } else {
+        found->second = free_.back();
+        free_.pop_back();
+      }
+      links_[found->second].pid = process.Pid();
+    }
+    Link& link = links_[found->second];
+    link.index = i;
+    if (added || link.ppid != process.PPid()) {
+      link.ppid = process.PPid();
+      relink_.emplace_back(found->second);
+    }
+  }
+  for (int slot : relink_) {
+    Detach(slot);
+    auto found = slots_.find(links_[slot].ppid);
+    int parent = found == slots_.end() ? 0 : found->second;
+    // a stale parent pid, read before the kernel reparented the process,
+    // could close a loop that would drop out of the tree
+    for (int up = parent; up > 0; up = links_[up].parent) {
+      if (up == slot) {
+        parent = 0;
+        break;
+      }
+    }
+    Attach(slot, parent);
+  }
+}
+
+/*
+ * Fills order with the indexes of processes in depth first order, and nodes,
+ * by index, with the depth of each process and the totals of its subtree.
+ * The totals are added up as the walk leaves each process.
+ */
+void ProcessTree::Flatten(const vector<Process>& processes,
+                          vector<unsigned int>& order,
+                          vector<TreeNode>& nodes) const {
+  order.clear();
+  nodes.assign(processes.size(), TreeNode());
+  unsigned int depth = 0;
+  int slot = links_[0].first_child;
+  while (slot > 0) {
+    const Link& link = links_[slot];
+    TreeNode& node = nodes[link.index];
+    node.depth = depth;
+    node.cpu += processes[link.index].CpuUtilization();
+    node.ram += processes[link.index].Ram();
+    order.emplace_back(link.index);
+    if (link.first_child >= 0) {
+      slot = link.first_child;
+      depth++;
+      continue;
+    }
+    // leave slot, and each parent whose last child has been left
+    while (slot > 0) {
+      const Link& done = links_[slot];
+      if (done.parent > 0) {
+        TreeNode& parent = nodes[links_[done.parent].index];
+        const TreeNode& child = nodes[done.index];
+        parent.cpu += child.cpu;
+        parent.ram += child.ram;
+        parent.descendants += child.descendants + 1;
+      }
+      if (done.next >= 0) {
+        slot = done.next;
+        break;
+      }
+      slot = done.parent;
+      depth--;
+    }
+  }
+}
@@ -3,7 +3,7 @@
 #include <string>
 #include <vector>
 
-#include "linux_parser.h"
+#include "stat_snapshot.h"
 
 using std::string;
 using std::vector;
@@ -19,6 +19,12 @@ Processor::Processor(int id) : id_(id) {
   idle_ = 0;
   cpu_util_ = 0.0;
 }
+// a recorded processor, which is never updated
+Processor::Processor(int id, float cpu_util) : id_(id) {
+  total_ = 0;
+  idle_ = 0;
+  cpu_util_ = cpu_util;
+}
 int Processor::Id() const { return id_; }
 unsigned long Processor::Jiffies() const { return total_; }
 unsigned long Processor::IdleJiffies() const { return idle_; }
@@ -28,9 +34,9 @@ void Processor::SetJiffies(unsigned long total) { total_ = total; }
 void Processor::SetIdleJiffies(unsigned long idle) { idle_ = idle; }
 void Processor::SetCpuUtilization(float cpu_util) { cpu_util_ = cpu_util; }
 
-void Processor::Update() {
-  unsigned long total_now = LinuxParser::Jiffies(Id());
-  unsigned long idle_now = LinuxParser::IdleJiffies(Id());
+void Processor::Update(const StatSnapshot& stat) {
+  unsigned long total_now = stat.Jiffies(Id());
+  unsigned long idle_now = stat.IdleJiffies(Id());
   unsigned long total_d = total_now - Jiffies();
   unsigned long idle_d = idle_now - IdleJiffies();
   if (total_d > 0) {
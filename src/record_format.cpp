@@ -0,0 +1,71 @@
+#include "record_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using std::string_view;
+using std::vector;
+
+uint32_t RecordFormat::Quantize(float fraction) {
+  if (!(fraction > 0.0)) {
+    return 0;
+  }
+  return (uint32_t)std::lround(std::min((double)fraction, 1e5) * kScale);
+}
+
+void RecordFormat::PutVarint(vector<char>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+// small negative numbers map to small unsigned ones: 0, -1, 1, -2, ...
+void RecordFormat::PutZigzag(vector<char>& out, int64_t value) {
+  PutVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void RecordFormat::PutString(vector<char>& out, string_view text) {
+  PutVarint(out, text.size());
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+/*
+ * The Get functions consume a value from the front of in, and return false
+ * if in ends before the value does.
+ */
+bool RecordFormat::GetVarint(string_view& in, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+    unsigned char byte = in.front();
+    in.remove_prefix(1);
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RecordFormat::GetZigzag(string_view& in, int64_t& value) {
+  uint64_t encoded;
+  if (!GetVarint(in, encoded)) {
+    return false;
+  }
+  value = (int64_t)(encoded >> 1) ^ -(int64_t)(encoded & 1);
+  return true;
+}
+
+bool RecordFormat::GetString(string_view& in, string_view& text) {
+  uint64_t size;
+  if (!GetVarint(in, size) || size > in.size()) {
+    return false;
+  }
+  text = in.substr(0, size);
+  in.remove_prefix(size);
+  return true;
+}
@@ -0,0 +1,164 @@
+#include "recorder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "output_buffer.h"
+#include "record_format.h"
+#include "snapshot.h"
+#include "system.h"
+
+using std::string;
+using std::string_view;
+using std::vector;
+using namespace RecordFormat;
+
+#define KEYFRAME_INTERVAL 60  // ticks between two keyframes
+
+/*
+ * Creates or truncates the file at path and writes the header, which
+ * describes the host that system samples.
+ */
+Recorder::Recorder(const string& path, const System& system)
+    : fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)),
+      out_(fd_) {
+  if (!IsOpen()) {
+    return;
+  }
+  records_.insert(records_.end(), kMagic.begin(), kMagic.end());
+  PutString(records_, system.Kernel());
+  PutString(records_, system.OperatingSystem());
+  PutVarint(records_, system.TotalCpus());
+  records_.push_back(system.ProcessEvents() ? 1 : 0);
+  out_.Append(string_view(records_.data(), records_.size()));
+  out_.Flush();
+  records_.clear();
+}
+
+Recorder::~Recorder() {
+  if (IsOpen()) {
+    out_.Flush();
+    close(fd_);
+  }
+}
+
+bool Recorder::IsOpen() const { return fd_ >= 0; }
+
+/*
+ * Returns the id of text, writing a string record the first time it is seen.
+ */
+uint32_t Recorder::Intern(const string& text) {
+  auto found = strings_.find(text);
+  if (found != strings_.end()) {
+    return found->second;
+  }
+  uint32_t id = strings_.size();
+  strings_.emplace(text, id);
+  records_.push_back(kString);
+  PutString(records_, text);
+  return id;
+}
+
+/*
+ * Appends entry to frame_, with only the fields that differ from base.
+ */
+void Recorder::Encode(const Entry& entry, const Entry& base,
+                      unsigned int last_pid) {
+  unsigned char fields = 0;
+  fields |= entry.user != base.user ? kUser : 0;
+  fields |= entry.command != base.command ? kCommand : 0;
+  fields |= entry.state != base.state ? kState : 0;
+  fields |= entry.cpu != base.cpu ? kCpu : 0;
+  fields |= entry.ram != base.ram ? kRam : 0;
+  fields |= entry.uptime != base.uptime ? kUpTime : 0;
+  PutVarint(frame_, entry.pid - last_pid);
+  frame_.push_back(fields);
+  if (fields & kUser) {
+    PutVarint(frame_, entry.user);
+  }
+  if (fields & kCommand) {
+    PutVarint(frame_, entry.command);
+  }
+  if (fields & kState) {
+    frame_.push_back(entry.state);
+  }
+  if (fields & kCpu) {
+    PutVarint(frame_, entry.cpu);
+  }
+  if (fields & kRam) {
+    PutZigzag(frame_, (int64_t)(entry.ram - base.ram));
+  }
+  if (fields & kUpTime) {
+    PutZigzag(frame_, (int64_t)(entry.uptime - base.uptime));
+  }
+}
+
+/*
+ * Writes the string records interned during this tick, then the tick itself.
+ */
+void Recorder::Flush(Record_t type) {
+  out_.Append(string_view(records_.data(), records_.size()));
+  records_.clear();
+  out_.Append((char)type);
+  PutVarint(records_, frame_.size());
+  out_.Append(string_view(records_.data(), records_.size()));
+  records_.clear();
+  out_.Append(string_view(frame_.data(), frame_.size()));
+  out_.Flush();
+}
+
+/*
+ * snapshot.processes is sorted by pid, as System keeps it, so each process is
+ * matched with its entry from the previous tick in a single merge pass.
+ */
+void Recorder::Write(const Snapshot& snapshot) {
+  if (!IsOpen()) {
+    return;
+  }
+  bool keyframe = frames_++ % KEYFRAME_INTERVAL == 0;
+  auto now = std::chrono::system_clock::now().time_since_epoch();
+  frame_.clear();
+  PutVarint(frame_, snapshot.tick);
+  PutVarint(frame_,
+            std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+  PutVarint(frame_, snapshot.uptime);
+  PutVarint(frame_, Quantize(snapshot.memory));
+  PutVarint(frame_, Quantize(snapshot.cpu.Utilization()));
+  for (const Processor& cpu : snapshot.cpus) {
+    PutVarint(frame_, Quantize(cpu.Utilization()));
+  }
+  PutVarint(frame_, snapshot.total_processes);
+  PutVarint(frame_, snapshot.running_processes);
+  PutVarint(frame_, snapshot.short_lived);
+  PutVarint(frame_, snapshot.processes.size());
+
+  current_.clear();
+  const Entry empty;
+  auto base = previous_.begin();
+  unsigned int last_pid = 0;
+  for (const Process& process : snapshot.processes) {
+    Entry entry;
+    entry.pid = process.Pid();
+    entry.user = Intern(process.User());
+    entry.command = Intern(process.Command());
+    entry.state = process.State();
+    entry.cpu = Quantize(process.CpuUtilization());
+    entry.ram = process.Ram();
+    entry.uptime = process.UpTime();
+    while (base != previous_.end() && base->pid < entry.pid) {
+      base++;
+    }
+    bool known = !keyframe && base != previous_.end() && base->pid == entry.pid;
+    Encode(entry, known ? *base : empty, last_pid);
+    last_pid = entry.pid;
+    current_.push_back(entry);
+  }
+  previous_.swap(current_);
+  Flush(keyframe ? kKeyframe : kDelta);
+}
@@ -0,0 +1,376 @@
+#include "replayer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "process.h"
+#include "processor.h"
+#include "record_format.h"
+#include "snapshot.h"
+
+using std::string;
+using std::string_view;
+using std::vector;
+using namespace RecordFormat;
+
+#define MAX_SPEED 1024.0
+#define SEEK_STEP 60.0        // seconds moved by [ and ]
+#define LONG_SEEK_STEP 600.0  // seconds moved by { and }
+
+/*
+ * speed scales the recorded pace, 2 plays twice as fast. IsOpen() is false if
+ * the file cannot be mapped or is not a recording.
+ */
+Replayer::Replayer(const string& path, double speed) : speed_(speed) {
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat status;
+  if (fstat(fd, &status) == 0 && status.st_size > 0) {
+    void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      data_ = (const char*)data;
+      size_ = status.st_size;
+    }
+  }
+  close(fd);
+  if (data_ && !Index()) {
+    munmap((void*)data_, size_);
+    data_ = nullptr;
+  }
+}
+
+Replayer::~Replayer() {
+  Stop();
+  close(timer_fd_);
+  if (data_) {
+    munmap((void*)data_, size_);
+  }
+}
+
+bool Replayer::IsOpen() const { return data_ != nullptr; }
+const string& Replayer::Kernel() const { return kernel_; }
+const string& Replayer::OperatingSystem() const { return os_; }
+int Replayer::TotalCpus() const { return total_cpus_; }
+
+// seconds of playback between the first and the last tick
+double Replayer::Duration() const { return frames_.back().offset / 1000.0; }
+
+/*
+ * Reads the header, then walks the records without decoding any tick. A
+ * record cut short at the end of the file, as left by a crash, is ignored.
+ * Returns false if the file is not a recording or holds no tick.
+ */
+bool Replayer::Index() {
+  string_view in(data_, size_);
+  if (in.substr(0, kMagic.size()) != kMagic) {
+    return false;
+  }
+  in.remove_prefix(kMagic.size());
+  string_view kernel, os;
+  uint64_t cpus;
+  if (!GetString(in, kernel) || !GetString(in, os) || !GetVarint(in, cpus) ||
+      in.empty()) {
+    return false;
+  }
+  kernel_ = string(kernel);
+  os_ = string(os);
+  total_cpus_ = cpus;
+  events_ = in.front() != 0;
+  in.remove_prefix(1);
+
+  size_t keyframe = 0;
+  uint64_t offset = 0;
+  while (!in.empty()) {
+    unsigned char type = in.front();
+    in.remove_prefix(1);
+    string_view payload;
+    if (!GetString(in, payload)) {
+      break;
+    }
+    if (type == kString) {
+      strings_.emplace_back(payload);
+      continue;
+    }
+    if (type == kKeyframe) {
+      keyframe = frames_.size();
+    } else if (type != kDelta || frames_.empty()) {
+      continue;
+    }
+    // the tick number comes first, then the time
+    string_view fields = payload;
+    uint64_t tick, time;
+    if (GetVarint(fields, tick) && GetVarint(fields, time)) {
+      // The wall clock may have been stepped back while recording, so a gap
+      // is taken as signed and clamped at 0. The offsets never decrease.
+      if (!frames_.empty()) {
+        offset += std::max(0LL, (long long)(time - frames_.back().time));
+      }
+      frames_.push_back({time, offset, payload, keyframe});
+    }
+  }
+  return !frames_.empty();
+}
+
+string Replayer::String(uint32_t id) const {
+  return id < strings_.size() ? string(strings_[id]) : string();
+}
+
+/*
+ * Decodes a tick into current_ and the system fields of snapshot. A delta
+ * tick has to follow the tick decoded before it. Returns false if the tick is
+ * corrupt.
+ */
+bool Replayer::Decode(size_t frame, Snapshot& snapshot) {
+  string_view in = frames_[frame].payload;
+  bool keyframe = frames_[frame].keyframe == frame;
+  bool sequential = decoded_ && position_ + 1 == frame;
+  uint64_t tick, time, uptime, memory, cpu, total, running, short_lived, count;
+  if (!GetVarint(in, tick) || !GetVarint(in, time) ||
+      !GetVarint(in, uptime) || !GetVarint(in, memory) ||
+      !GetVarint(in, cpu)) {
+    return false;
+  }
+  snapshot.tick = tick;
+  snapshot.uptime = uptime;
+  snapshot.memory = memory / kScale;
+  snapshot.cpu = Processor(-1, cpu / kScale);
+  snapshot.cpus.clear();
+  for (int i = 0; i < total_cpus_; i++) {
+    if (!GetVarint(in, cpu)) {
+      return false;
+    }
+    snapshot.cpus.emplace_back(Processor(i, cpu / kScale));
+  }
+  if (!GetVarint(in, total) || !GetVarint(in, running) ||
+      !GetVarint(in, short_lived) || !GetVarint(in, count)) {
+    return false;
+  }
+  snapshot.total_processes = total;
+  snapshot.running_processes = running;
+  snapshot.short_lived = short_lived;
+  snapshot.process_events = events_;
+
+  previous_.swap(current_);
+  current_.clear();
+  const Entry empty;
+  auto base = previous_.begin();
+  unsigned int pid = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t delta, value;
+    int64_t change;
+    if (!GetVarint(in, delta) || in.empty()) {
+      return false;
+    }
+    pid += delta;
+    unsigned char fields = in.front();
+    in.remove_prefix(1);
+    while (base != previous_.end() && base->pid < pid) {
+      base++;
+    }
+    bool known = !keyframe && base != previous_.end() && base->pid == pid;
+    Entry entry = known ? *base : empty;
+    entry.pid = pid;
+    if (fields & kUser) {
+      if (!GetVarint(in, value)) {
+        return false;
+      }
+      entry.user = value;
+    }
+    if (fields & kCommand) {
+      if (!GetVarint(in, value)) {
+        return false;
+      }
+      entry.command = value;
+    }
+    if (fields & kState) {
+      if (in.empty()) {
+        return false;
+      }
+      entry.state = in.front();
+      in.remove_prefix(1);
+    }
+    if (fields & kCpu) {
+      if (!GetVarint(in, value)) {
+        return false;
+      }
+      entry.cpu = value;
+    }
+    if (fields & kRam) {
+      if (!GetZigzag(in, change)) {
+        return false;
+      }
+      entry.ram += change;
+    }
+    if (fields & kUpTime) {
+      if (!GetZigzag(in, change)) {
+        return false;
+      }
+      entry.uptime += change;
+    }
+    current_.push_back(entry);
+  }
+
+  // processes of the previous tick that are gone from this one have exited
+  exited_.clear();
+  if (sequential) {
+    auto alive = current_.begin();
+    for (const Entry& entry : previous_) {
+      while (alive != current_.end() && alive->pid < entry.pid) {
+        alive++;
+      }
+      if (alive == current_.end() || alive->pid != entry.pid) {
+        exited_.push_back(entry);
+      }
+    }
+  }
+  position_ = frame;
+  decoded_ = true;
+  return true;
+}
+
+/*
+ * Decodes a tick, starting from its keyframe unless it follows the tick
+ * decoded last, and publishes it.
+ */
+void Replayer::Show(size_t frame) {
+  // Show() runs on the display thread, which is also the only reader of the
+  // snapshots, so a use_count() of 1 means the display has let go of the
+  // buffer, and no ordering between threads is involved.
+  std::shared_ptr<Snapshot>& snapshot = buffers_[back_];
+  back_ ^= 1;
+  if (!snapshot || snapshot.use_count() > 1) {
+    snapshot = std::make_shared<Snapshot>();
+  }
+  size_t first = frames_[frame].keyframe;
+  if (decoded_ && position_ < frame && position_ >= first) {
+    first = position_ + 1;
+  }
+  for (size_t i = first; i <= frame; i++) {
+    if (!Decode(i, *snapshot)) {
+      decoded_ = false;
+      break;
+    }
+  }
+
+  auto restore = [this](const Entry& entry) {
+    Process process(entry.pid, String(entry.user), String(entry.command));
+    process.Restore(entry.state, entry.cpu / kScale, entry.ram, entry.uptime);
+    return process;
+  };
+  snapshot->processes.clear();
+  for (const Entry& entry : current_) {
+    snapshot->processes.emplace_back(restore(entry));
+  }
+  snapshot->exited.clear();
+  for (const Entry& entry : exited_) {
+    snapshot->exited.emplace_back(restore(entry));
+  }
+  latest_ = snapshot;
+}
+
+/*
+ * Schedules the next tick after the recorded gap scaled by the speed, or
+ * disarms the timer when paused or at the end of the recording.
+ */
+void Replayer::Arm() {
+  struct itimerspec next {};
+  if (started_ && !paused_ && position_ + 1 < frames_.size()) {
+    double gap = (frames_[position_ + 1].offset - frames_[position_].offset) /
+                 1000.0 / speed_;
+    long long ns = std::max(1LL, (long long)(gap * 1e9));
+    next.it_value.tv_sec = ns / 1000000000;
+    next.it_value.tv_nsec = ns % 1000000000;
+  }
+  timerfd_settime(timer_fd_, 0, &next, nullptr);
+}
+
+/*
+ * Moves playback to the last tick at most seconds after the first tick.
+ */
+void Replayer::Seek(double seconds) {
+  uint64_t target = std::max(0.0, seconds * 1000);
+  auto after = std::upper_bound(frames_.begin(), frames_.end(), target,
+                                [](uint64_t offset, const Frame& frame) {
+                                  return offset < frame.offset;
+                                });
+  size_t frame = after == frames_.begin() ? 0 : after - frames_.begin() - 1;
+  Show(frame);
+  Arm();
+}
+
+void Replayer::Start() {
+  started_ = true;
+  if (!latest_) {
+    Show(0);
+  }
+  Arm();
+}
+
+void Replayer::Stop() {
+  started_ = false;
+  Arm();
+}
+
+std::shared_ptr<const Snapshot> Replayer::Latest() const { return latest_; }
+
+// readable when the next tick is due
+int Replayer::ReadyFd() const { return timer_fd_; }
+
+void Replayer::ClearReady() {
+  uint64_t expirations;
+  if (read(timer_fd_, &expirations, sizeof(expirations)) > 0 &&
+      position_ + 1 < frames_.size()) {
+    Show(position_ + 1);
+    Arm();
+  }
+}
+
+/*
+ * Space pauses and resumes, < and > halve and double the speed, [ and ] seek
+ * back and forward a minute, { and } ten minutes.
+ */
+bool Replayer::Key(int key) {
+  double now = frames_[position_].offset / 1000.0;
+  switch (key) {
+    case ' ':
+      paused_ = !paused_;
+      break;
+    case '<':
+    case ',':
+      speed_ = std::max(1.0 / MAX_SPEED, speed_ / 2);
+      break;
+    case '>':
+    case '.':
+      speed_ = std::min(MAX_SPEED, speed_ * 2);
+      break;
+    case '[':
+      Seek(now - SEEK_STEP);
+      return true;
+    case ']':
+      Seek(now + SEEK_STEP);
+      return true;
+    case '{':
+      Seek(now - LONG_SEEK_STEP);
+      return true;
+    case '}':
+      Seek(now + LONG_SEEK_STEP);
+      return true;
+    default:
+      return false;
+  }
+  Arm();
+  return true;
+}
@@ -0,0 +1,59 @@
+#include "row_cache.h"
+
+#include <curses.h>
+
+#include <string>
+#include <string_view>
+
+using std::string_view;
+
+// unchanged characters that are rewritten rather than split into two spans,
+// since moving the cursor costs about as much
+#define SPAN_GAP 4
+
+void RowCache::Invalidate() {
+  rows_.clear();
+  attributes_.clear();
+}
+
+/*
+ * text is the whole row from col, already padded to the width it covers. A
+ * row drawn for the first time, or with a new width, is written in full.
+ */
+void RowCache::Draw(WINDOW* window, int row, int col, string_view text,
+                    attr_t attributes) {
+  if (row < 0) {
+    return;
+  }
+  if ((size_t)row >= rows_.size()) {
+    rows_.resize(row + 1);
+    attributes_.resize(row + 1, A_NORMAL);
+  }
+  std::string& drawn = rows_[row];
+  wattron(window, attributes);
+  if (drawn.size() != text.size() || attributes_[row] != attributes) {
+    mvwaddnstr(window, row, col, text.data(), text.size());
+    wattroff(window, attributes);
+    drawn.assign(text);
+    attributes_[row] = attributes;
+    return;
+  }
+  size_t i = 0;
+  while (i < text.size()) {
+    if (text[i] == drawn[i]) {
+      i++;
+      continue;
+    }
+    size_t start = i;
+    size_t end = i + 1;  // one past the last changed character
+    for (size_t j = end; j < text.size() && j < end + SPAN_GAP; j++) {
+      if (text[j] != drawn[j]) {
+        end = j + 1;
+      }
+    }
+    mvwaddnstr(window, row, col + start, text.data() + start, end - start);
+    drawn.replace(start, end - start, text.substr(start, end - start));
+    i = end;
+  }
+  wattroff(window, attributes);
+}
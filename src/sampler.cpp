@@ -0,0 +1,147 @@
+#include "sampler.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "snapshot.h"
+#include "system.h"
+
+Sampler::Sampler(System& system, std::chrono::milliseconds interval)
+    : system_(system), interval_(interval) {
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  ready_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+Sampler::~Sampler() {
+  Stop();
+  close(timer_fd_);
+  close(stop_fd_);
+  close(ready_fd_);
+}
+
+/*
+ * recorder must outlive the Sampler, and be set before Start(). While
+ * recording, every process is read in full and not just those on screen.
+ */
+void Sampler::SetRecorder(Recorder* recorder) {
+  recorder_ = recorder;
+  system_.SetFullDetail(recorder != nullptr);
+}
+
+/*
+ * Takes the first sample on the calling thread, so a snapshot is available as
+ * soon as Start() returns, then arms the timer and starts the sampling thread.
+ */
+void Sampler::Start() {
+  if (thread_.joinable()) {
+    return;
+  }
+  Sample();
+  auto seconds = std::chrono::duration_cast<std::chrono::seconds>(interval_);
+  auto nanoseconds =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(interval_ - seconds);
+  struct itimerspec period {};
+  period.it_interval.tv_sec = seconds.count();
+  period.it_interval.tv_nsec = nanoseconds.count();
+  period.it_value = period.it_interval;
+  timerfd_settime(timer_fd_, 0, &period, nullptr);
+  thread_ = std::thread(&Sampler::Loop, this);
+}
+
+void Sampler::Stop() {
+  if (thread_.joinable()) {
+    uint64_t one = 1;
+    write(stop_fd_, &one, sizeof(one));
+    thread_.join();
+  }
+}
+
+std::shared_ptr<const Snapshot> Sampler::Latest() const {
+  return std::atomic_load(&latest_);
+}
+
+/*
+ * Readable whenever a snapshot has been published since the last call to
+ * ClearReady().
+ */
+int Sampler::ReadyFd() const { return ready_fd_; }
+
+void Sampler::ClearReady() {
+  uint64_t count;
+  read(ready_fd_, &count, sizeof(count));
+}
+
+void Sampler::Loop() {
+  // signals such as SIGWINCH are left for the display thread to handle
+  sigset_t signals;
+  sigfillset(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  struct pollfd fds[2] = {{timer_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      continue;
+    }
+    if (fds[1].revents & POLLIN) {
+      return;
+    }
+    if (fds[0].revents & POLLIN) {
+      // if sampling overran one or more periods, those ticks are skipped and
+      // the next sample stays on the original schedule
+      uint64_t expirations;
+      read(timer_fd_, &expirations, sizeof(expirations));
+      Sample();
+    }
+  }
+}
+
+void Sampler::Sample() {
+  system_.UpdateProcesses();
+  system_.UpdateProcessors();
+
+  // The back buffer is not the published snapshot, so only the display can
+  // share it, from an earlier tick. Reuse it when nobody else holds it, which
+  // keeps the capacity of its vectors and strings. No new reference to it can
+  // be taken, as Latest() hands out the other buffer, so a count of 1 stays 1.
+  // use_count() is a relaxed load, though, and the display drops its reference
+  // with a release decrement: the acquire fence orders that drop, and every
+  // read the display made of the buffer before it, ahead of the refill.
+  std::shared_ptr<Snapshot>& snapshot = buffers_[back_];
+  back_ ^= 1;
+  if (!snapshot || snapshot.use_count() > 1) {
+    snapshot = std::make_shared<Snapshot>();
+  } else {
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  snapshot->tick = ++ticks_;
+  snapshot->processes = system_.Processes();
+  snapshot->exited = system_.Exited();
+  snapshot->threads = system_.Threads();
+  snapshot->tree_order = system_.TreeOrder();
+  snapshot->tree = system_.Tree();
+  snapshot->cpu = system_.Cpu();
+  snapshot->cpus = system_.Cpus();
+  snapshot->memory = system_.MemoryUtilization();
+  snapshot->uptime = system_.UpTime();
+  snapshot->total_processes = system_.TotalProcesses();
+  snapshot->running_processes = system_.RunningProcesses();
+  snapshot->short_lived = system_.ShortLived();
+  snapshot->process_events = system_.ProcessEvents();
+  std::atomic_store(&latest_, std::shared_ptr<const Snapshot>(snapshot));
+  uint64_t one = 1;
+  write(ready_fd_, &one, sizeof(one));
+  if (recorder_) {
+    recorder_->Write(*snapshot);
+  }
+}
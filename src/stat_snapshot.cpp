@@ -0,0 +1,110 @@
+#include "stat_snapshot.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "linux_parser.h"
+
+using std::string_view;
+
+StatSnapshot::StatSnapshot()
+    : StatSnapshot(LinuxParser::ProcPath(LinuxParser::kStatFilename)) {}
+
+// an empty path gives a snapshot that is never filled
+StatSnapshot::StatSnapshot(std::string path) : file_(std::move(path)) {}
+
+/*
+ * Reads /proc/stat once and stores every value needed for this tick. A cpu
+ * line is matched on its full key, so "cpu1" no longer matches "cpu10".
+ * Once the array has grown to fit every cpu, an update does not allocate.
+ */
+void StatSnapshot::Update() {
+  using LinuxParser::NextLine;
+  using LinuxParser::NextToken;
+  using LinuxParser::ParseNumber;
+
+  string_view contents = file_.Read();
+  if (contents.empty()) {
+    return;
+  }
+  int cpus = 0;
+  std::fill(cpus_.begin(), cpus_.end(), 0);
+  while (!contents.empty()) {
+    string_view line = NextLine(contents);
+    string_view key = NextToken(line);
+    if (key.compare(0, LinuxParser::kCpu.size(), LinuxParser::kCpu) == 0) {
+      string_view id = key.substr(LinuxParser::kCpu.size());
+      size_t slot = 0;
+      if (!std::all_of(id.begin(), id.end(), isdigit)) {
+        continue;
+      }
+      // slot 0 holds the aggregate cpu, slot N + 1 holds cpuN
+      if (ParseNumber(id, slot)) {
+        slot++;
+      }
+      if (cpus_.size() < (slot + 1) * kFields) {
+        cpus_.resize((slot + 1) * kFields, 0);
+      }
+      for (int i = 0; i < kFields; i++) {
+        if (!ParseNumber(NextToken(line), cpus_[slot * kFields + i])) {
+          break;
+        }
+      }
+      cpus = std::max(cpus, (int)slot);
+    } else if (key == LinuxParser::kProcesses) {
+      ParseNumber(NextToken(line), processes_);
+    } else if (key == LinuxParser::kProcsRunning) {
+      ParseNumber(NextToken(line), procs_running_);
+    } else if (key == LinuxParser::kCtxt) {
+      ParseNumber(NextToken(line), ctxt_);
+    } else if (key == LinuxParser::kIntr) {
+      ParseNumber(NextToken(line), intr_);
+    }
+  }
+  total_cpus_ = cpus;
+}
+
+int StatSnapshot::TotalCpus() const { return total_cpus_; }
+unsigned long StatSnapshot::TotalProcesses() const { return processes_; }
+unsigned long StatSnapshot::RunningProcesses() const { return procs_running_; }
+unsigned long StatSnapshot::ContextSwitches() const { return ctxt_; }
+unsigned long StatSnapshot::Interrupts() const { return intr_; }
+
+/*
+ * Returns the counter for the given CPUStates value of the cpu at index, or 0
+ * if that cpu was not present in the last snapshot.
+ */
+unsigned long StatSnapshot::Value(int index, int state) const {
+  size_t i = (index + 1) * kFields + state - LinuxParser::CPUStates::kUser_;
+  if (index < -1 || i >= cpus_.size()) {
+    return 0;
+  }
+  return cpus_[i];
+}
+
+unsigned long StatSnapshot::Jiffies(int index) const {
+  unsigned long total = 0;
+  for (int i = LinuxParser::CPUStates::kUser_;
+       i <= LinuxParser::CPUStates::kSteal_; i++) {
+    total += Value(index, i);
+  }
+  return total;
+}
+
+unsigned long StatSnapshot::ActiveJiffies(int index) const {
+  unsigned long active = Value(index, LinuxParser::CPUStates::kUser_);
+  active += Value(index, LinuxParser::CPUStates::kNice_);
+  active += Value(index, LinuxParser::CPUStates::kSystem_);
+  active += Value(index, LinuxParser::CPUStates::kIRQ_);
+  active += Value(index, LinuxParser::CPUStates::kSoftIRQ_);
+  active += Value(index, LinuxParser::CPUStates::kSteal_);
+  return active;
+}
+
+unsigned long StatSnapshot::IdleJiffies(int index) const {
+  return Value(index, LinuxParser::CPUStates::kIdle_) +
+         Value(index, LinuxParser::CPUStates::kIOwait_);
+}
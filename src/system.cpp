@@ -2,10 +2,10 @@
 
 #include <algorithm>
 #include <cstddef>
-#include <functional>
 #include <string>
 #include <vector>
 
+#include "instrumentation.h"
 #include "linux_parser.h"
 #include "process.h"
 #include "processor.h"
@@ -14,134 +14,373 @@ using std::size_t;
 using std::string;
 using std::vector;
 
-System::System() {
+#define SAMPLE_CHUNK 64  // processes claimed by a worker at a time
+
+/*
+ * workers sets the number of threads sampling processes, 0 selects
+ * WorkerPool::DefaultSize(). events tracks processes with the kernel proc
+ * connector when it is available, instead of scanning /proc every tick.
+ */
+System::System(size_t workers, bool events)
+    : meminfo_file_(LinuxParser::ProcPath(LinuxParser::kMeminfoFilename)),
+      uptime_file_(LinuxParser::ProcPath(LinuxParser::kUptimeFilename)),
+      users_(LinuxParser::EtcPath(LinuxParser::kPasswordFilename)),
+      pid_scanner_(LinuxParser::ProcDirectory()),
+      pool_(workers),
+      recycled_(pool_.Size()) {
   aggregate_cpu_ = Processor();
-  total_cpus_ = LinuxParser::GetTotalCpus();
+  stat_.Update();
+  total_cpus_ = stat_.TotalCpus();
   for (int i = 0; i < total_cpus_; i++) {
     cpus_.emplace_back(Processor(i));
   }
   kernel_ = LinuxParser::Kernel();
   os_ = LinuxParser::OperatingSystem();
+  // the proc connector reports the pids of this machine, not of another root
+  if (events && LinuxParser::DefaultProcRoot()) {
+    events_ = std::make_unique<ProcEvents>();
+    if (!events_->IsOpen()) {
+      events_.reset();
+    }
+  }
 }
 
+/*
+ * Describes a recorded host for a replay. Only the display settings of such a
+ * System are used, it is never updated, so none of the files of this machine
+ * are opened and no worker thread is started.
+ */
+System::System(string kernel, string os, int total_cpus)
+    : total_cpus_(total_cpus),
+      stat_(string()),
+      meminfo_file_(string()),
+      uptime_file_(string()),
+      users_(string()),
+      pid_scanner_(string()),
+      pool_(1),
+      recycled_(pool_.Size()),
+      kernel_(std::move(kernel)),
+      os_(std::move(os)) {}
+
 int System::TotalCpus() const { return total_cpus_; }
 Processor& System::Cpu() { return aggregate_cpu_; }
 vector<Processor>& System::Cpus() { return cpus_; }
 vector<Process>& System::Processes() { return processes_; }
+const vector<Process>& System::Exited() const { return exited_; }
+const vector<Process>& System::Threads() const { return threads_; }
+const vector<unsigned int>& System::TreeOrder() const { return tree_order_; }
+const vector<TreeNode>& System::Tree() const { return tree_nodes_; }
 string System::Kernel() const { return kernel_; }
 string System::OperatingSystem() const { return os_; }
 unsigned long System::RunningProcesses() const {
-  return LinuxParser::RunningProcesses();
+  return stat_.RunningProcesses();
+}
+unsigned long System::TotalProcesses() const { return stat_.TotalProcesses(); }
+unsigned long System::UpTime() const {
+  return (unsigned long)LinuxParser::UpTime(uptime_file_.Read());
 }
-unsigned long System::TotalProcesses() const {
-  return LinuxParser::TotalProcesses();
+bool System::ProcessEvents() const { return events_ != nullptr; }
+unsigned long System::ShortLived() const {
+  return events_ ? events_->ShortLived() : 0;
 }
-unsigned long System::UpTime() const { return LinuxParser::UpTime(); }
 float System::MemoryUtilization() const {
-  return LinuxParser::MemoryUtilization();
+  return LinuxParser::MemoryUtilization(meminfo_file_.Read());
 }
 bool System::ShowCores() const { return show_cores_; };
-void System::ToggleCores() { show_cores_ = !show_cores_; }
+void System::ToggleCores() { show_cores_ = !show_cores_.load(); }
+bool System::ShowTimings() const { return show_timings_; }
+void System::ToggleTimings() { show_timings_ = !show_timings_.load(); }
+bool System::ShowThreads() const { return show_threads_; }
+void System::ToggleThreads() { show_threads_ = !show_threads_.load(); }
+bool System::ShowTree() const { return show_tree_; }
+void System::ToggleTree() { show_tree_ = !show_tree_.load(); }
+bool System::ShowHistory() const { return show_history_; }
+void System::ToggleHistory() { show_history_ = !show_history_.load(); }
 System::Sort_t System::Sort() const { return sort_; }
 void System::SetSort(Sort_t s) { sort_ = s; }
 bool System::Descending() const { return descending_; }
 void System::SetDescending(bool d) { descending_ = d; }
 
+/*
+ * Called by the display with the pids of the rows on screen or near them, which
+ * are read on every tick however idle they are, and are the only ones whose
+ * RAM is read unless the display sorts by it. The list is picked up by the
+ * next tick.
+ */
+void System::SetVisiblePids(const vector<unsigned int>& pids) {
+  std::lock_guard<std::mutex> lock(visible_mutex_);
+  visible_pids_.assign(pids.begin(), pids.end());
+}
+
+// the timings of this System's ticks, to which a display adds its own
+Instrumentation& System::Timings() { return timings_; }
+
+/*
+ * Reads the RAM of every process on every read, for a Recorder that keeps all
+ * of them and not just those on screen.
+ */
+void System::SetFullDetail(bool full) { full_detail_ = full; }
+
 void System::UpdateProcessors() {
-  Cpu().Update();
+  stat_.Update();
+  Cpu().Update(stat_);
   for (auto& cpu : cpus_) {
-    cpu.Update();
+    cpu.Update(stat_);
   }
 }
 
+/*
+ * Processes are read on a tiered schedule: anything that used cpu recently,
+ * or that is on screen, is read every tick, while idle processes are read at
+ * a decaying rate (see Process::UpdateSchedule()). Skipped processes only
+ * have their age refreshed. /proc/[pid]/status, which only holds the RAM, is
+ * read for the processes near the screen, or for all of them when sorting by
+ * RAM, as any of them could make it onto the screen, or when showing the tree,
+ * whose subtree totals add up the RAM of every process. On the tick that
+ * turns this on, every process is read, however idle, since an idle process
+ * may hold a stale RAM value, or none at all. Afterwards an idle process is
+ * still read out of turn until its RAM has been read once. With threads shown,
+ * the threads of the processes near the screen are read as well.
+ */
 void System::UpdateProcesses() {
+  generation_++;
   AddProcesses();
 
-  for (auto& process : processes_) {
-    process.Update();
+  // read /proc/uptime once for every process updated during this tick
+  double uptime = LinuxParser::UpTime(uptime_file_.Read());
+  {
+    std::lock_guard<std::mutex> lock(visible_mutex_);
+    visible_.assign(visible_pids_.begin(), visible_pids_.end());
+  }
+  std::sort(visible_.begin(), visible_.end());
+  bool detail = full_detail_ || sort_ == kRam_ || show_tree_;
+  bool refresh = detail && !detailed_;
+  detailed_ = detail;
+  // Each Process is only touched by the worker that claimed its chunk, and
+  // the parser buffers are per thread, so the hot loop takes no locks.
+  {
+    ScopedTimer timer(timings_, Instrumentation::kParse_);
+    pool_.Run(processes_.size(), SAMPLE_CHUNK,
+              [this, uptime, detail, refresh](size_t worker, size_t begin,
+                                              size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                  Process& process = processes_[i];
+                  bool visible = std::binary_search(
+                      visible_.begin(), visible_.end(), process.Pid());
+                  bool stale = detail && (refresh || !process.RamRead());
+                  if (!process.Due(generation_) && !visible && !stale) {
+                    process.UpdateUpTime(uptime);
+                    continue;
+                  }
+                  process.Update(uptime, generation_, detail || visible);
+                  if (process.isRecycled()) {
+                    recycled_[worker].emplace_back(i);
+                  }
+                }
+              });
   }
 
-  RemoveProcesses();
-  SortProcesses();
+  // UserCache is not thread safe, so reused pids are handled afterwards
+  {
+    ScopedTimer timer(timings_, Instrumentation::kReconcile_);
+    for (auto& recycled : recycled_) {
+      for (unsigned int i : recycled) {
+        processes_[i] = NewProcess(processes_[i].Pid());
+        processes_[i].MarkSeen(generation_);
+        processes_[i].Update(uptime, generation_);
+      }
+      recycled.clear();
+    }
+    RemoveProcesses();
+    UpdateTree();
+  }
+  {
+    ScopedTimer timer(timings_, Instrumentation::kParse_);
+    UpdateThreads(uptime);
+  }
+  timings_.EndTick(Instrumentation::kScan_, Instrumentation::kReconcile_);
 }
 
+Process System::NewProcess(unsigned int pid) {
+  string command = LinuxParser::Command(pid);
+  string user;
+  unsigned int uid;
+  if (LinuxParser::ParseNumber(LinuxParser::Uid(pid), uid)) {
+    user = users_.Name(uid);
+  }
+  if (command.empty()) {
+    // On my Ubuntu 21.10 VM at home, I was getting many processes with
+    // blank command lines. This is my solution for not displaying a
+    // bunch of blank lines. It turns out this does not seem to be an
+    // issue on the Udacity Ubuntu 16.04.6 VM workspace.
+    command = LinuxParser::Filename(pid);
+  }
+  return Process(pid, user, command);
+}
+
+/*
+ * The live pids come from the proc connector when it is open, and from a scan
+ * of /proc on the first tick, without the connector, or after events were
+ * lost. Both the pids and processes_ are sorted, so a single merge pass marks
+ * every listed process as seen during this tick and finds the new pids in
+ * linear time. New processes are appended and merged into place. Processes
+ * that are not listed any more are left behind with an old generation, and a
+ * pid that has been reused is detected by Process::Update() from its start
+ * time.
+ */
 void System::AddProcesses() {
-  for (unsigned int pid : LinuxParser::Pids()) {
-    if (std::find(processes_.begin(), processes_.end(), pid) ==
-        processes_.end()) {
-      string command = LinuxParser::Command(pid);
-      string user = LinuxParser::User(pid);
-      if (command.empty()) {
-        // On my Ubuntu 21.10 VM at home, I was getting many processes with
-        // blank command lines. This is my solution for not displaying a
-        // bunch of blank lines. It turns out this does not seem to be an
-        // issue on the Udacity Ubuntu 16.04.6 VM workspace.
-        command = LinuxParser::Filename(pid);
+  users_.Refresh();
+  {
+    ScopedTimer timer(timings_, Instrumentation::kScan_);
+    // pids_ is only empty before the first scan, there is always an init
+    if (!events_ || pids_.empty() || !events_->Update(pids_, execs_)) {
+      pid_scanner_.Scan(pids_);
+      if (!std::is_sorted(pids_.begin(), pids_.end())) {
+        std::sort(pids_.begin(), pids_.end());
+      }
+      execs_.clear();
+    }
+  }
+  ScopedTimer timer(timings_, Instrumentation::kReconcile_);
+  size_t known = processes_.size();
+  size_t i = 0;
+  for (unsigned int pid : pids_) {
+    while (i < known && processes_[i].Pid() < pid) {
+      i++;
+    }
+    if (i < known && processes_[i].Pid() == pid) {
+      // a new program has a new command line, and may run as another user
+      if (std::binary_search(execs_.begin(), execs_.end(), pid)) {
+        processes_[i] = NewProcess(pid);
       }
-      processes_.emplace_back(Process(pid, user, command));
+      processes_[i].MarkSeen(generation_);
+    } else {
+      processes_.emplace_back(NewProcess(pid));
+      processes_.back().MarkSeen(generation_);
     }
   }
+  if (processes_.size() > known) {
+    std::inplace_merge(
+        processes_.begin(), processes_.begin() + known, processes_.end(),
+        [](const Process& a, const Process& b) { return a.Pid() < b.Pid(); });
+  }
 }
 
-void System::RemoveProcesses() {
-  std::sort(processes_.begin(), processes_.end(),
-            [total = TotalProcesses()](Process& a, Process& b) {
-              return a.State() < b.State();
-            });
-
-  // Verify if process has been killed, and pop it off
-  while (processes_.back().isKilled()) {
-    processes_.pop_back();
+/*
+ * Keeps the tree of the live processes while it is shown, from the processes
+ * that exited or changed parent during this tick, and lays it out for the
+ * display with the totals of every subtree. The links are dropped when the
+ * tree is hidden, and rebuilt from every process when it is shown again.
+ */
+void System::UpdateTree() {
+  if (!show_tree_) {
+    if (!tree_order_.empty()) {
+      tree_.Clear();
+      tree_order_.clear();
+      tree_nodes_.clear();
+    }
+    return;
   }
+  tree_.Remove(exited_);
+  tree_.Update(processes_);
+  tree_.Flatten(processes_, tree_order_, tree_nodes_);
 }
 
-void System::SortProcesses() {
-  std::function<bool(Process & a, Process & b)> sort_function;
-  switch (Sort()) {
-    case kPid_: {
-      sort_function = [d = Descending()](Process& a, Process& b) {
-        return d ? a.Pid() > b.Pid() : a.Pid() < b.Pid();
-      };
-      break;
-    }
-    case kUser_: {
-      sort_function = [d = Descending()](Process& a, Process& b) {
-        return d ? a.User() > b.User() : a.User() < b.User();
-      };
-      break;
+/*
+ * Lists and reads the threads of the processes near the screen that have more
+ * than one, when the display shows threads. Threads of every other process are
+ * dropped, so the cost is bounded by the rows on screen and not by the number
+ * of threads on the system. A thread is read like a process, from the same
+ * stat fields, so its CPU% is the delta of its own times since its last read.
+ * Threads that were already listed keep that state, and are matched by a
+ * merge of the sorted lists. Their RAM is that of the process, and not read.
+ */
+void System::UpdateThreads(double uptime) {
+  if (!show_threads_) {
+    threads_.clear();
+    return;
+  }
+  next_threads_.clear();
+  auto old = threads_.begin();
+  for (unsigned int pid : visible_) {
+    auto process = std::lower_bound(
+        processes_.begin(), processes_.end(), pid,
+        [](const Process& p, unsigned int pid) { return p.Pid() < pid; });
+    if (process == processes_.end() || process->Pid() != pid ||
+        process->Threads() <= 1) {
+      continue;
     }
-    case kState_: {
-      sort_function = [d = Descending()](Process& a, Process& b) {
-        return d ? a.State() > b.State() : a.State() < b.State();
-      };
-      break;
+    pid_scanner_.Scan(LinuxParser::PidPath(pid, LinuxParser::kTaskDirectory),
+                      tids_);
+    if (!std::is_sorted(tids_.begin(), tids_.end())) {
+      std::sort(tids_.begin(), tids_.end());
     }
-    default:
-    case kCpu_: {
-      sort_function = [d = Descending()](Process& a, Process& b) {
-        return d ? b < a : a < b;
-      };
-      break;
+    while (old != threads_.end() && old->Tgid() < pid) {
+      old++;
     }
-    case kRam_: {
-      sort_function = [d = Descending()](Process& a, Process& b) {
-        return d ? stof(a.Ram()) > stof(b.Ram())
-                 : stof(a.Ram()) < stof(b.Ram());
-      };
-      break;
+    for (unsigned int tid : tids_) {
+      while (old != threads_.end() && old->Tgid() == pid && old->Pid() < tid) {
+        old++;
+      }
+      if (old != threads_.end() && old->Tgid() == pid && old->Pid() == tid) {
+        next_threads_.emplace_back(std::move(*old));
+      } else {
+        next_threads_.emplace_back(tid, process->User(),
+                                   LinuxParser::ThreadName(pid, tid), pid);
+      }
+      next_threads_.back().MarkSeen(generation_);
     }
-    case kUpTime_: {
-      sort_function = [d = Descending()](Process& a, Process& b) {
-        return d ? a.UpTime() > b.UpTime() : a.UpTime() < b.UpTime();
-      };
-      break;
+  }
+  threads_.swap(next_threads_);
+  pool_.Run(threads_.size(), SAMPLE_CHUNK,
+            [this, uptime](size_t, size_t begin, size_t end) {
+              for (size_t i = begin; i < end; i++) {
+                threads_[i].Update(uptime, generation_, false);
+              }
+            });
+  // a thread that exited since the listing, or whose id was reused, is gone
+  // until the next listing
+  threads_.erase(std::remove_if(threads_.begin(), threads_.end(),
+                                [this](const Process& thread) {
+                                  return thread.Generation() != generation_ ||
+                                         thread.isRecycled();
+                                }),
+                 threads_.end());
+}
+
+/*
+ * Moves every process that was not seen during this tick to exited_ in a
+ * single stable pass, keeping the live processes sorted by pid.
+ */
+void System::RemoveProcesses() {
+  exited_.clear();
+  auto alive = processes_.begin();
+  for (auto& process : processes_) {
+    if (process.Generation() != generation_) {
+      exited_.emplace_back(std::move(process));
+    } else {
+      if (&*alive != &process) {
+        *alive = std::move(process);
+      }
+      alive++;
     }
-    case kCommand_: {
-      sort_function = [d = Descending()](Process& a, Process& b) {
-        return d ? a.Command() > b.Command() : a.Command() < b.Command();
-      };
-      break;
+  }
+  processes_.erase(alive, processes_.end());
+
+  // With the proc connector, pids_ carries over to the next tick. Drop the
+  // pids whose stat could not be read, so they are not tried again. Both lists
+  // are sorted by pid, so this is a single merge pass.
+  if (events_ && !exited_.empty()) {
+    auto gone = exited_.begin();
+    auto kept = pids_.begin();
+    for (unsigned int pid : pids_) {
+      while (gone != exited_.end() && gone->Pid() < pid) {
+        gone++;
+      }
+      if (gone == exited_.end() || gone->Pid() != pid) {
+        *kept++ = pid;
+      }
     }
+    pids_.erase(kept, pids_.end());
   }
-  std::sort(processes_.begin(), processes_.end(), sort_function);
-}
\ No newline at end of file
+}
@@ -0,0 +1,80 @@
+#include "user_cache.h"
+
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "linux_parser.h"
+
+using std::string;
+using std::string_view;
+
+UserCache::UserCache(string path) : path_(std::move(path)) { Refresh(); }
+
+/*
+ * Reloads the cache if the password file has been modified since it was last
+ * parsed. Meant to be called once per tick, before any lookups. An empty path
+ * leaves the cache empty.
+ */
+void UserCache::Refresh() {
+  struct stat st;
+  if (path_.empty() || stat(path_.c_str(), &st) != 0) {
+    return;
+  }
+  if (st.st_mtim.tv_sec != mtime_.tv_sec ||
+      st.st_mtim.tv_nsec != mtime_.tv_nsec) {
+    mtime_ = st.st_mtim;
+    Load();
+  }
+}
+
+void UserCache::Load() {
+  names_.clear();
+  string_view contents = LinuxParser::ReadFile(path_.c_str());
+  while (!contents.empty()) {
+    string_view line = LinuxParser::NextLine(contents);
+    string_view fields[LinuxParser::User::kUid_ + 1];
+    int count = 0;
+    while (count <= LinuxParser::User::kUid_) {
+      size_t colon = line.find(':');
+      fields[count++] = line.substr(0, colon);
+      if (colon == string_view::npos) {
+        break;
+      }
+      line.remove_prefix(colon + 1);
+    }
+    unsigned int uid;
+    if (count > LinuxParser::User::kUid_ &&
+        LinuxParser::ParseNumber(fields[LinuxParser::User::kUid_], uid)) {
+      // the first entry for a uid wins, as it does for getpwuid()
+      names_.emplace(uid, string(fields[LinuxParser::User::kUserName_]));
+    }
+  }
+}
+
+/*
+ * Returns the user name for uid, or an empty string if it can not be resolved.
+ */
+string UserCache::Name(unsigned int uid) {
+  auto found = names_.find(uid);
+  if (found != names_.end()) {
+    return found->second;
+  }
+  string name;
+  long size = sysconf(_SC_GETPW_R_SIZE_MAX);
+  std::vector<char> buffer(size > 0 ? size : 16384);
+  struct passwd pwd;
+  struct passwd* result = nullptr;
+  if (getpwuid_r(uid, &pwd, buffer.data(), buffer.size(), &result) == 0 &&
+      result != nullptr) {
+    name = result->pw_name;
+  }
+  // misses are cached too, so an unknown uid is only looked up once
+  names_.emplace(uid, name);
+  return name;
+}
@@ -0,0 +1,125 @@
+#include "worker_pool.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+/*
+ * A size of 0 selects DefaultSize().
+ */
+WorkerPool::WorkerPool(size_t size)
+    : size_(size > 0 ? size : DefaultSize()), ranges_(new Range[size_]) {
+  for (size_t worker = 1; worker < size_; worker++) {
+    threads_.emplace_back(&WorkerPool::Loop, this, worker);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+size_t WorkerPool::Size() const { return size_; }
+
+/*
+ * One worker for every four online cpus, and at least one.
+ */
+size_t WorkerPool::DefaultSize() {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return std::max(1L, cpus / 4);
+}
+
+/*
+ * Four workers for every online cpu. More would only contend for the cpus,
+ * and could exhaust the threads a process may create.
+ */
+size_t WorkerPool::MaxSize() {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return std::max(1L, cpus) * 4;
+}
+
+/*
+ * Runs task over [0, count) in chunks of at most chunk items, and returns once
+ * every chunk has been processed.
+ */
+void WorkerPool::Run(size_t count, size_t chunk, const Task& task) {
+  if (count == 0) {
+    return;
+  }
+  if (size_ == 1) {
+    task(0, 0, count);
+    return;
+  }
+  size_t share = count / size_;
+  size_t extra = count % size_;
+  size_t begin = 0;
+  for (size_t worker = 0; worker < size_; worker++) {
+    size_t end = begin + share + (worker < extra ? 1 : 0);
+    ranges_[worker].next.store(begin, std::memory_order_relaxed);
+    ranges_[worker].end = end;
+    begin = end;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    chunk_ = std::max<size_t>(chunk, 1);
+    busy_ = size_ - 1;
+    job_++;
+  }
+  start_.notify_all();
+  Work(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  task_ = nullptr;
+}
+
+void WorkerPool::Loop(size_t worker) {
+  // signals such as SIGWINCH are left for the display thread to handle
+  sigset_t signals;
+  sigfillset(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  unsigned long job = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [this, job] { return stop_ || job_ != job; });
+      if (stop_) {
+        return;
+      }
+      job = job_;
+    }
+    Work(worker);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busy_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+/*
+ * Drains the worker's own range first, then visits every other range in turn
+ * and steals whatever chunks are left in it.
+ */
+void WorkerPool::Work(size_t worker) {
+  for (size_t i = 0; i < size_; i++) {
+    Range& range = ranges_[(worker + i) % size_];
+    while (true) {
+      size_t begin = range.next.fetch_add(chunk_, std::memory_order_relaxed);
+      if (begin >= range.end) {
+        break;
+      }
+      (*task_)(worker, begin, std::min(begin + chunk_, range.end));
+    }
+  }
+}
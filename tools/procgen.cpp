@@ -0,0 +1,584 @@
+/*
+procgen builds a synthetic /proc and /etc tree for benchmarking the monitor
+
+  procgen [options] DIR
+
+creates DIR/proc and DIR/etc, holding the files the monitor reads: stat,
+uptime, meminfo and version, and stat, status and cmdline for every process,
+then passwd and os-release. The tree is then kept changing on every tick:
+some processes use cpu time, and some exit and are replaced by new ones.
+Point the monitor at it with --proc DIR/proc --etc DIR/etc. DIR should be on
+a tmpfs such as /dev/shm, so the benchmark measures the monitor and not the
+disk.
+
+Per process files are written under a temporary name and renamed into place,
+and a new process directory is filled before it is renamed to its pid, so the
+monitor never reads a partial file. The system wide files are kept open by the
+monitor, so they are rewritten in place with a single pwrite(). The last line
+is padded with spaces up to the old length, so a file never has to be
+truncated, which would leave a window where the monitor reads a stale tail.
+*/
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+#define PID_MAX 4194304      // the largest pid_max of a 64 bit kernel
+#define BOOT_UPTIME 86400.0  // seconds the synthetic machine has been up
+#define MEM_TOTAL 67108864UL  // kB of synthetic memory
+
+namespace {
+volatile sig_atomic_t stopping = 0;
+
+void Stop(int) { stopping = 1; }
+
+// the first one is only run by pid 1
+const char* const kPrograms[] = {"/sbin/init",
+                                 "/usr/sbin/sshd",
+                                 "/usr/lib/systemd/systemd-journald",
+                                 "/usr/bin/python3",
+                                 "/usr/local/bin/worker",
+                                 "/usr/bin/bash",
+                                 "/usr/sbin/nginx",
+                                 "/usr/lib/jvm/bin/java",
+                                 "/usr/bin/postgres",
+                                 "/usr/bin/containerd-shim",
+                                 "/usr/bin/node"};
+const unsigned int kTotalPrograms = sizeof(kPrograms) / sizeof(kPrograms[0]);
+
+struct FakeProcess {
+  unsigned int pid;
+  unsigned int ppid;
+  unsigned int uid;
+  unsigned int program;
+  char state;
+  unsigned long utime;
+  unsigned long stime;
+  unsigned long rss;  // kB
+  unsigned long long starttime;
+  // children of the same parent are linked by pid, 0 ending a list
+  unsigned int first_child{0};
+  unsigned int prev_sibling{0};
+  unsigned int next_sibling{0};
+};
+
+struct Options {
+  string root;
+  unsigned long processes{10000};
+  unsigned long churn{0};
+  double active{5.0};  // percent of processes using cpu on a tick
+  unsigned int users{32};
+  unsigned int cpus{8};
+  double delay{1.0};
+  unsigned long iterations{0};
+  bool once{false};
+  unsigned int seed{1};
+};
+
+/*
+ * Writes contents to path under a temporary name, then renames it into place.
+ * Returns false if either step failed.
+ */
+bool WriteFile(const string& path, const string& contents) {
+  string temporary = path + ".tmp";
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0444);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = write(fd, contents.data(), contents.size()) ==
+            (ssize_t)contents.size();
+  close(fd);
+  return ok && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+/*
+ * Replaces the contents of path in place, for a file the monitor keeps open.
+ * contents ends with a newline, before which spaces are added when it is
+ * shorter than the file, so every byte of the file is overwritten and the
+ * file only ever grows.
+ */
+bool RewriteFile(const string& path, string contents) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0444);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) == 0 && (size_t)status.st_size > contents.size()) {
+    size_t padding = status.st_size - contents.size();
+    contents.insert(contents.empty() ? 0 : contents.size() - 1, padding, ' ');
+  }
+  bool ok = pwrite(fd, contents.data(), contents.size(), 0) ==
+            (ssize_t)contents.size();
+  close(fd);
+  return ok;
+}
+
+class ProcTree {
+ public:
+  explicit ProcTree(const Options& options);
+  bool Build();
+  bool Tick();
+  size_t Size() const;
+
+ private:
+  const Options& options_;
+  string proc_;
+  string etc_;
+  long ticks_per_second_;
+  std::mt19937 random_;
+  vector<FakeProcess> processes_;
+  vector<bool> used_;  // indexed by pid
+  std::unordered_map<unsigned int, size_t> index_;  // into processes_, by pid
+  unsigned int next_pid_{1};
+  unsigned long forks_{0};
+  unsigned long context_switches_{0};
+  unsigned long interrupts_{0};
+  vector<unsigned long> cpu_busy_;
+  vector<unsigned long> cpu_idle_;
+  std::chrono::steady_clock::time_point start_;
+
+  double UpTime() const;
+  string PidDirectory(unsigned int pid) const;
+  bool Spawn();
+  bool Exit(size_t index);
+  void Link(FakeProcess& process);
+  void Unlink(const FakeProcess& process);
+  bool WriteStat(const FakeProcess& process, const string& directory) const;
+  bool WriteStatus(const FakeProcess& process, const string& directory) const;
+  bool WriteSystem() const;
+};
+
+ProcTree::ProcTree(const Options& options)
+    : options_(options),
+      proc_(options.root + "/proc"),
+      etc_(options.root + "/etc"),
+      ticks_per_second_(sysconf(_SC_CLK_TCK)),
+      random_(options.seed),
+      used_(PID_MAX + 1),
+      cpu_busy_(options.cpus),
+      cpu_idle_(options.cpus),
+      start_(std::chrono::steady_clock::now()) {}
+
+size_t ProcTree::Size() const { return processes_.size(); }
+
+double ProcTree::UpTime() const {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start_;
+  return BOOT_UPTIME + elapsed.count();
+}
+
+string ProcTree::PidDirectory(unsigned int pid) const {
+  return proc_ + "/" + std::to_string(pid);
+}
+
+/*
+ * Creates the tree, refusing to touch a DIR/proc or DIR/etc that already
+ * exists, and spawns the initial processes.
+ */
+bool ProcTree::Build() {
+  if (mkdir(proc_.c_str(), 0755) != 0 || mkdir(etc_.c_str(), 0755) != 0) {
+    fprintf(stderr, "procgen: cannot create %s and %s: %s\n", proc_.c_str(),
+            etc_.c_str(), strerror(errno));
+    return false;
+  }
+  string passwd;
+  for (unsigned int uid = 0; uid < options_.users; uid++) {
+    string name = uid == 0 ? "root" : "user" + std::to_string(uid);
+    passwd += name + ":x:" + std::to_string(uid) + ":" + std::to_string(uid) +
+              "::/home/" + name + ":/bin/sh\n";
+  }
+  if (!WriteFile(etc_ + "/passwd", passwd) ||
+      !WriteFile(etc_ + "/os-release",
+                 "NAME=\"procgen\"\nPRETTY_NAME=\"procgen synthetic tree\"\n") ||
+      !WriteFile(proc_ + "/version",
+                 "Linux version 0.0.0-procgen (procgen) #1 SMP\n")) {
+    return false;
+  }
+  for (unsigned long i = 0; i < options_.processes; i++) {
+    if (!Spawn()) {
+      return false;
+    }
+  }
+  return WriteSystem();
+}
+
+/*
+ * Adds a process with the next free pid, as the child of a random live
+ * process. Pid 1 is the first one spawned, and never exits.
+ */
+bool ProcTree::Spawn() {
+  while (used_[next_pid_]) {
+    next_pid_ = next_pid_ == PID_MAX ? 2 : next_pid_ + 1;
+  }
+  FakeProcess process;
+  process.pid = next_pid_;
+  process.ppid =
+      processes_.empty() ? 0 : processes_[random_() % processes_.size()].pid;
+  process.uid = process.pid == 1 ? 0 : random_() % options_.users;
+  process.program =
+      process.pid == 1 ? 0 : 1 + random_() % (kTotalPrograms - 1);
+  process.state = 'S';
+  process.utime = 0;
+  process.stime = 0;
+  // on average, the processes use half of the memory
+  process.rss = 64 + random_() % std::max(1UL, MEM_TOTAL / options_.processes);
+  process.starttime = (unsigned long long)(UpTime() * ticks_per_second_);
+  used_[process.pid] = true;
+  forks_++;
+
+  // filled under a name the monitor skips, then renamed to the pid
+  string staging = proc_ + "/.new";
+  string program = kPrograms[process.program];
+  string cmdline = program + '\0' + "--id=" + std::to_string(process.pid) + '\0';
+  if (mkdir(staging.c_str(), 0755) != 0 ||
+      !WriteFile(staging + "/cmdline", cmdline) ||
+      !WriteStatus(process, staging) || !WriteStat(process, staging) ||
+      rename(staging.c_str(), PidDirectory(process.pid).c_str()) != 0) {
+    fprintf(stderr, "procgen: cannot create %s: %s\n",
+            PidDirectory(process.pid).c_str(), strerror(errno));
+    return false;
+  }
+  index_[process.pid] = processes_.size();
+  processes_.push_back(process);
+  Link(processes_.back());
+  return true;
+}
+
+// adds process to the front of the children of its parent, if it has one
+void ProcTree::Link(FakeProcess& process) {
+  process.prev_sibling = process.next_sibling = 0;
+  if (process.ppid == 0) {
+    return;
+  }
+  FakeProcess& parent = processes_[index_.at(process.ppid)];
+  process.next_sibling = parent.first_child;
+  if (parent.first_child != 0) {
+    processes_[index_.at(parent.first_child)].prev_sibling = process.pid;
+  }
+  parent.first_child = process.pid;
+}
+
+void ProcTree::Unlink(const FakeProcess& process) {
+  if (process.ppid == 0) {
+    return;
+  }
+  if (process.prev_sibling != 0) {
+    processes_[index_.at(process.prev_sibling)].next_sibling =
+        process.next_sibling;
+  } else {
+    processes_[index_.at(process.ppid)].first_child = process.next_sibling;
+  }
+  if (process.next_sibling != 0) {
+    processes_[index_.at(process.next_sibling)].prev_sibling =
+        process.prev_sibling;
+  }
+}
+
+/*
+ * Removes the process at index, renaming its directory away first so the
+ * monitor sees it disappear at once, and moves its children to init. Only
+ * the children are visited, through the links kept by Link(), so an exit
+ * does not scan the whole tree.
+ */
+bool ProcTree::Exit(size_t index) {
+  unsigned int pid = processes_[index].pid;
+  string dead = proc_ + "/.dead";
+  if (rename(PidDirectory(pid).c_str(), dead.c_str()) != 0) {
+    return false;
+  }
+  for (const char* file : {"/stat", "/status", "/cmdline"}) {
+    unlink((dead + file).c_str());
+  }
+  rmdir(dead.c_str());
+  used_[pid] = false;
+  Unlink(processes_[index]);
+  // orphans are adopted by init, as the kernel would
+  unsigned int child = processes_[index].first_child;
+  while (child != 0) {
+    FakeProcess& orphan = processes_[index_.at(child)];
+    child = orphan.next_sibling;
+    orphan.ppid = 1;
+    Link(orphan);
+    string directory = PidDirectory(orphan.pid);
+    if (!WriteStat(orphan, directory) || !WriteStatus(orphan, directory)) {
+      return false;
+    }
+  }
+  index_.erase(pid);
+  if (index + 1 < processes_.size()) {
+    processes_[index] = processes_.back();
+    index_[processes_[index].pid] = index;
+  }
+  processes_.pop_back();
+  return true;
+}
+
+bool ProcTree::WriteStat(const FakeProcess& process,
+                         const string& directory) const {
+  string program = kPrograms[process.program];
+  string comm = program.substr(program.rfind('/') + 1).substr(0, 15);
+  // pid (comm) state ppid pgrp session tty_nr tpgid flags minflt cminflt
+  // majflt cmajflt utime stime cutime cstime priority nice num_threads
+  // itrealvalue starttime vsize rss
+  string stat = std::to_string(process.pid) + " (" + comm + ") " +
+                process.state + " " + std::to_string(process.ppid) + " " +
+                std::to_string(process.pid) + " " +
+                std::to_string(process.pid) + " 0 -1 4194304 100 0 0 0 " +
+                std::to_string(process.utime) + " " +
+                std::to_string(process.stime) + " 0 0 20 0 1 0 " +
+                std::to_string(process.starttime) + " " +
+                std::to_string(process.rss * 4096) + " " +
+                std::to_string(process.rss / 4) + "\n";
+  return WriteFile(directory + "/stat", stat);
+}
+
+bool ProcTree::WriteStatus(const FakeProcess& process,
+                           const string& directory) const {
+  string program = kPrograms[process.program];
+  string comm = program.substr(program.rfind('/') + 1).substr(0, 15);
+  string status = "Name:\t" + comm + "\nState:\tS (sleeping)\nPid:\t" +
+                  std::to_string(process.pid) + "\nPPid:\t" +
+                  std::to_string(process.ppid) + "\nUid:\t" +
+                  std::to_string(process.uid) + "\t" +
+                  std::to_string(process.uid) + "\t" +
+                  std::to_string(process.uid) + "\t" +
+                  std::to_string(process.uid) + "\nVmRSS:\t" +
+                  std::to_string(process.rss) + " kB\nThreads:\t1\n";
+  return WriteFile(directory + "/status", status);
+}
+
+/*
+ * Rewrites stat, uptime and meminfo. The cpu counters advance by the time
+ * since the last tick, split between busy and idle by the share of processes
+ * that were running.
+ */
+bool ProcTree::WriteSystem() const {
+  double uptime = UpTime();
+  unsigned long running = std::count_if(
+      processes_.begin(), processes_.end(),
+      [](const FakeProcess& process) { return process.state == 'R'; });
+  unsigned long busy = 0, idle = 0;
+  string cpus;
+  for (unsigned int i = 0; i < options_.cpus; i++) {
+    busy += cpu_busy_[i];
+    idle += cpu_idle_[i];
+    cpus += "cpu" + std::to_string(i) + " " + std::to_string(cpu_busy_[i]) +
+            " 0 0 " + std::to_string(cpu_idle_[i]) + " 0 0 0 0 0 0\n";
+  }
+  string stat = "cpu  " + std::to_string(busy) + " 0 0 " +
+                std::to_string(idle) + " 0 0 0 0 0 0\n" + cpus + "intr " +
+                std::to_string(interrupts_) + "\nctxt " +
+                std::to_string(context_switches_) + "\nbtime 0\nprocesses " +
+                std::to_string(forks_) + "\nprocs_running " +
+                std::to_string(std::max(1UL, running)) +
+                "\nprocs_blocked 0\n";
+  unsigned long used = 0;
+  for (const FakeProcess& process : processes_) {
+    used += process.rss;
+  }
+  used = std::min(used, (unsigned long)MEM_TOTAL);
+  unsigned long available = MEM_TOTAL - used;
+  string meminfo = "MemTotal:       " + std::to_string(MEM_TOTAL) +
+                   " kB\nMemFree:        " + std::to_string(available) +
+                   " kB\nMemAvailable:   " + std::to_string(available) +
+                   " kB\n";
+  char uptime_line[64];
+  snprintf(uptime_line, sizeof(uptime_line), "%.2f %.2f\n", uptime,
+           uptime * options_.cpus);
+  return RewriteFile(proc_ + "/stat", stat) &&
+         RewriteFile(proc_ + "/meminfo", meminfo) &&
+         RewriteFile(proc_ + "/uptime", uptime_line);
+}
+
+/*
+ * Replaces options_.churn processes, then lets a random share of the rest use
+ * cpu time. Only the stat of a process whose values changed is rewritten.
+ */
+bool ProcTree::Tick() {
+  for (unsigned long i = 0; i < options_.churn && processes_.size() > 1; i++) {
+    // index 0 is pid 1, which never exits
+    size_t index = 1 + random_() % (processes_.size() - 1);
+    if (!Exit(index) || !Spawn()) {
+      return false;
+    }
+  }
+  unsigned long tick_jiffies = (unsigned long)(options_.delay *
+                                               ticks_per_second_);
+  // the active processes share the cpus, about fully used on average, though
+  // each of them uses at least one jiffy
+  unsigned long capacity = tick_jiffies * options_.cpus;
+  unsigned long active_processes = std::max(
+      1UL, (unsigned long)(processes_.size() * options_.active / 100.0));
+  unsigned long slice = std::max(1UL, 2 * capacity / active_processes);
+  std::uniform_real_distribution<double> percent(0.0, 100.0);
+  unsigned long busy = 0;
+  for (FakeProcess& process : processes_) {
+    bool active = percent(random_) < options_.active;
+    if (!active && process.state == 'S') {
+      continue;
+    }
+    process.state = active ? 'R' : 'S';
+    if (active) {
+      unsigned long used = 1 + random_() % std::min(slice, tick_jiffies);
+      process.utime += used - used / 4;
+      process.stime += used / 4;
+      busy += used;
+    }
+    if (!WriteStat(process, PidDirectory(process.pid))) {
+      return false;
+    }
+  }
+  for (unsigned int i = 0; i < options_.cpus; i++) {
+    unsigned long share = std::min(tick_jiffies, busy / options_.cpus);
+    cpu_busy_[i] += share;
+    cpu_idle_[i] += tick_jiffies - share;
+  }
+  context_switches_ += busy * 10;
+  interrupts_ += tick_jiffies * options_.cpus;
+  return WriteSystem();
+}
+
+void Usage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [options] DIR\n"
+          "Builds a synthetic proc tree in DIR/proc and DIR/etc, then keeps "
+          "it changing.\n"
+          "  -p, --processes N   processes in the tree (default: 10000)\n"
+          "  -c, --churn N       processes replaced on every tick "
+          "(default: 0)\n"
+          "  -a, --active PCT    percent of processes using cpu on a tick "
+          "(default: 5)\n"
+          "  -u, --users N       distinct users (default: 32)\n"
+          "  -C, --cpus N        cpus (default: 8)\n"
+          "  -d, --delay SECS    seconds between ticks (default: 1)\n"
+          "  -n, --iterations N  stop after N ticks (default: 0, no limit)\n"
+          "  -o, --once          build the tree and exit\n"
+          "  -S, --seed N        random seed (default: 1)\n",
+          name);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  const struct option long_options[] = {
+      {"processes", required_argument, nullptr, 'p'},
+      {"churn", required_argument, nullptr, 'c'},
+      {"active", required_argument, nullptr, 'a'},
+      {"users", required_argument, nullptr, 'u'},
+      {"cpus", required_argument, nullptr, 'C'},
+      {"delay", required_argument, nullptr, 'd'},
+      {"iterations", required_argument, nullptr, 'n'},
+      {"once", no_argument, nullptr, 'o'},
+      {"seed", required_argument, nullptr, 'S'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "p:c:a:u:C:d:n:oS:h", long_options,
+                            nullptr)) != -1) {
+    switch (opt) {
+      case 'p':
+        options.processes = strtoul(optarg, nullptr, 10);
+        break;
+      case 'c':
+        options.churn = strtoul(optarg, nullptr, 10);
+        break;
+      case 'a':
+        options.active = strtod(optarg, nullptr);
+        break;
+      case 'u':
+        options.users = std::max(1UL, strtoul(optarg, nullptr, 10));
+        break;
+      case 'C':
+        options.cpus = std::max(1UL, strtoul(optarg, nullptr, 10));
+        break;
+      case 'd':
+        options.delay = strtod(optarg, nullptr);
+        if (!(options.delay >= 0.01)) {
+          fprintf(stderr, "%s: delay must be at least 0.01 seconds\n",
+                  argv[0]);
+          return 1;
+        }
+        break;
+      case 'n':
+        options.iterations = strtoul(optarg, nullptr, 10);
+        break;
+      case 'o':
+        options.once = true;
+        break;
+      case 'S':
+        options.seed = strtoul(optarg, nullptr, 10);
+        break;
+      case 'h':
+        Usage(argv[0]);
+        return 0;
+      default:
+        Usage(argv[0]);
+        return 1;
+    }
+  }
+  if (optind + 1 != argc) {
+    Usage(argv[0]);
+    return 1;
+  }
+  options.root = argv[optind];
+  if (options.processes < 1 || options.processes >= PID_MAX) {
+    fprintf(stderr, "%s: processes must be between 1 and %d\n", argv[0],
+            PID_MAX - 1);
+    return 1;
+  }
+
+  ProcTree tree(options);
+  auto start = std::chrono::steady_clock::now();
+  if (!tree.Build()) {
+    return 1;
+  }
+  std::chrono::duration<double> built = std::chrono::steady_clock::now() - start;
+  fprintf(stderr, "procgen: %zu processes in %s/proc, built in %.2f s\n",
+          tree.Size(), options.root.c_str(), built.count());
+  if (options.once) {
+    return 0;
+  }
+
+  signal(SIGINT, Stop);
+  signal(SIGTERM, Stop);
+  // ticks are scheduled on absolute times, so they do not drift by the time
+  // spent writing
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  long long step = (long long)(options.delay * 1e9);
+  for (unsigned long tick = 0;
+       !stopping && (options.iterations == 0 || tick < options.iterations);
+       tick++) {
+    long long ns = next.tv_nsec + step;
+    next.tv_sec += ns / 1000000000;
+    next.tv_nsec = ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) ==
+               EINTR &&
+           !stopping) {
+    }
+    if (!stopping && !tree.Tick()) {
+      fprintf(stderr, "procgen: cannot update the tree: %s\n",
+              strerror(errno));
+      return 1;
+    }
+  }
+  return 0;
+}